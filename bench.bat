@@ -0,0 +1,6 @@
+@echo off
+g++ -std=c++11 -O2 -pthread source/Logger_bench.cpp -o Logger_bench
+Logger_bench.exe
+g++ -std=c++11 -O2 -pthread source/Logger_load_bench.cpp source/Logger_async.cpp source/Logger_mmap.cpp source/Logger_file.cpp source/Logger_lane.cpp source/Logger_rotate.cpp source/Logger_crash.cpp -o Logger_load_bench
+Logger_load_bench.exe 100000 bench_results.csv
+@pause
\ No newline at end of file
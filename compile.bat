@@ -1,4 +1,4 @@
 @echo off
-g++ -std=c++11 -pthread source/Logger.cpp source/Logger_async.cpp -o Logger
+g++ -std=c++11 -pthread source/Logger.cpp source/Logger_async.cpp source/Logger_mmap.cpp source/Logger_file.cpp source/Logger_lane.cpp source/Logger_rotate.cpp source/Logger_crash.cpp -o Logger
 Logger.exe
 @pause
\ No newline at end of file
@@ -0,0 +1,3 @@
+@echo off
+g++ -std=c++11 source/Logger_decode.cpp -o Logger_decode
+Logger_decode.exe %*
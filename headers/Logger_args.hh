@@ -0,0 +1,725 @@
+#ifndef LOGGER_ARGS_HH
+#define LOGGER_ARGS_HH
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Binary capture and deferred rendering of log message arguments.
+ *
+ * A producer encodes the arguments of a "{}"-style format as a tagged byte stream: one type byte
+ * followed by the raw value, or by a 32-bit length and the bytes for text. Builtin arithmetic types,
+ * C strings and std::string are copied as they are; any other type is rendered with operator<< at
+ * encode time and stored as text. render() turns format and bytes back into the message text on
+ * the consuming thread.
+ *
+ * size_of() renders each such value once, into a thread-local scratch list, and the encode() that
+ * follows it on the same thread copies that text, so the bytes written always match the size
+ * reserved for them.
+ *
+ * A key-value field, made with field(), is stored as its key followed by the encoded value. Fields
+ * never fill a placeholder; render() appends them as " key=value" after the message, and structured
+ * outputs read them back with field_key().
+ *
+ * Every function that walks encoded bytes takes the end of the buffer and stops at an argument that
+ * would run past it, so bytes read back from a file can be rendered without trusting their lengths.
+ *
+ * Example:
+ * @code
+ *   unsigned char data[64];
+ *   std::size_t size = Logger_args::size_of(42, "abc");
+ *   Logger_args::encode(data, 42, "abc");
+ *   std::string text;
+ *   Logger_args::render("answer={} name={}", data, size, text);   // "answer=42 name=abc"
+ *
+ *   size = Logger_args::size_of("done", Logger_args::field("latency_us", 123));
+ *   Logger_args::encode(data, "done", Logger_args::field("latency_us", 123));
+ *   text.clear();
+ *   Logger_args::render("request {}", data, size, text);           // "request done latency_us=123"
+ * @endcode
+ */
+class Logger_args {
+    public:
+        /**
+        * @brief Enum for the type byte in front of every encoded argument.
+        */
+        enum class Type : unsigned char {
+            Int,
+            Uint,
+            Double,
+            Bool,
+            Char,
+            String,
+            Field
+        };
+
+        /**
+        * @brief A key-value argument, made with field(). It refers to the value, so it has to be
+        *        encoded within the expression that made it.
+        */
+        template <typename T>
+        struct Field_arg {
+            const char* key;
+            const T& value;
+        };
+
+        /**
+        * @brief        A key-value field of a log message, e.g. field("latency_us", elapsed_us).
+        */
+        template <typename T>
+        static Field_arg<T> field(const char* key, const T& value) {
+            return Field_arg<T>{key, value};
+        }
+
+        /**
+        * @brief        Number of bytes encode() will write for args. Values without a builtin encoding
+        *               are rendered here and kept for the next encode() on this thread.
+        */
+        template <typename... Args>
+        static std::size_t size_of(const Args&... args) {
+            Scratch& texts = scratch();
+            texts.sized = 0;
+            texts.encoded = 0;
+            return sizes(args...);
+        }
+
+        /**
+        * @brief        Encode args into data, which must hold size_of(args...) bytes; call size_of()
+        *               with the same arguments on the same thread first.
+        * @return       Pointer one past the last byte written.
+        */
+        template <typename... Args>
+        static unsigned char* encode(unsigned char* data, const Args&... args) {
+            scratch().encoded = 0;
+            return put_all(data, args...);
+        }
+
+        /**
+        * @brief        Append format to out with every "{}" replaced by the next encoded argument.
+        * @param format The format string captured by the producer.
+        * @param data   Encoded arguments.
+        * @param size   Number of encoded bytes.
+        * @param out    String the message is appended to.
+        * @param fields Append the key-value fields as " key=value"; outputs that store them apart pass false.
+        * @param signal_safe Render numbers with a fraction with format_double() instead of snprintf(),
+        *               for a signal handler; out must then have the capacity for the text already.
+        * @return       False if the bytes are malformed; out then ends at the last argument that was whole.
+        *
+        * Placeholders without an argument are copied as they are; arguments without a placeholder
+        * are appended separated by spaces so nothing the caller logged is lost.
+        */
+        static bool render(const char* format, const unsigned char* data, std::size_t size, std::string& out, bool fields = true,
+                           bool signal_safe = false) {
+            const unsigned char* end = data + size;
+            bool has_fields = false;
+            const unsigned char* next = skip_fields(data, end, has_fields);
+            const char* segment = format;
+            const char* cursor = format;
+            while (*cursor) {
+                if (cursor[0] == '{' && cursor[1] == '}' && next && next < end) {
+                    out.append(segment, cursor - segment);
+                    next = skip_fields(render_arg(next, end, out, signal_safe), end, has_fields);
+                    cursor += 2;
+                    segment = cursor;
+                }
+                else {
+                    cursor++;
+                }
+            }
+            out.append(segment, cursor - segment);
+            while (next && next < end) {
+                out.push_back(' ');
+                next = skip_fields(render_arg(next, end, out, signal_safe), end, has_fields);
+            }
+            if (!next) return false;
+            if (!fields || !has_fields) return true;
+            for (next = data; next && next < end; next = skip_arg(next, end)) {
+                if (static_cast<Type>(*next) != Type::Field) continue;
+                out.push_back(' ');
+                render_arg(next, end, out, signal_safe);
+            }
+            return true;
+        }
+
+        /**
+        * @brief        Position of the argument after the one at data, or nullptr if it runs past end.
+        */
+        static const unsigned char* skip_arg(const unsigned char* data, const unsigned char* end) {
+            while (data && data < end && static_cast<Type>(*data) == Type::Field) data = skip_text(data + 1, end);
+            if (!data || data >= end) return nullptr;
+            switch (static_cast<Type>(*data++)) {
+            case Type::Int:
+            case Type::Uint:
+            case Type::Double:
+                return fits(data, end, 8) ? data + 8 : nullptr;
+            case Type::Bool:
+            case Type::Char:
+                return fits(data, end, 1) ? data + 1 : nullptr;
+            case Type::String:
+                return skip_text(data, end);
+            case Type::Field:
+                break;
+            }
+            return nullptr;
+        }
+
+        /**
+        * @brief        Read the key of the field at data.
+        * @return       Position of the field's encoded value, or nullptr if data is not a field or
+        *               its key runs past end.
+        */
+        static const unsigned char* field_key(const unsigned char* data, const unsigned char* end, const char*& key, std::uint32_t& key_length) {
+            if (data >= end || static_cast<Type>(*data) != Type::Field) return nullptr;
+            data++;
+            if (!take_length(data, end, key_length)) return nullptr;
+            key = reinterpret_cast<const char*>(data);
+            return data + key_length;
+        }
+
+        /**
+        * @brief        Render one encoded argument and return the position of the next one, or nullptr
+        *               if it runs past end.
+        *
+        * A field's keys are walked in a loop, so a corrupt run of nested fields cannot exhaust the stack.
+        */
+        static const unsigned char* render_arg(const unsigned char* data, const unsigned char* end, std::string& out, bool signal_safe = false) {
+            const char* key;
+            std::uint32_t key_length;
+            while (data < end && static_cast<Type>(*data) == Type::Field) {
+                data = field_key(data, end, key, key_length);
+                if (!data) return nullptr;
+                out.append(key, key_length).push_back('=');
+            }
+            if (data >= end) return nullptr;
+            Type type = static_cast<Type>(*data++);
+            if (type != Type::String && !fits(data, end, type == Type::Bool || type == Type::Char ? 1 : 8)) return nullptr;
+            switch (type) {
+            case Type::Int: {
+                std::int64_t value;
+                std::memcpy(&value, data, sizeof(value));
+                append_int(value, out);
+                return data + sizeof(value);
+            }
+            case Type::Uint: {
+                std::uint64_t value;
+                std::memcpy(&value, data, sizeof(value));
+                append_uint(value, out);
+                return data + sizeof(value);
+            }
+            case Type::Double: {
+                double value;
+                std::memcpy(&value, data, sizeof(value));
+                if (signal_safe) {
+                    char text[Double_length];
+                    out.append(text, format_double(value, text));
+                }
+                else {
+                    append_double(value, out);
+                }
+                return data + sizeof(value);
+            }
+            case Type::Bool:
+                out.append(*data ? "true" : "false");
+                return data + 1;
+            case Type::Char:
+                out.push_back(static_cast<char>(*data));
+                return data + 1;
+            case Type::String: {
+                std::uint32_t length;
+                if (!take_length(data, end, length)) return nullptr;
+                out.append(reinterpret_cast<const char*>(data), length);
+                return data + length;
+            }
+            case Type::Field:
+                break;
+            }
+            return nullptr;
+        }
+
+        /**
+        * @brief        Append the decimal digits of value without going through a stream.
+        *
+        * Digits are produced two at a time from a table into a local buffer and appended at once.
+        */
+        static void append_uint(std::uint64_t value, std::string& out) {
+            static const char pairs[] =
+                "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+                "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+                "8081828384858687888990919293949596979899";
+            char digits[20];
+            char* cursor = digits + sizeof(digits);
+            while (value >= 100) {
+                const char* pair = pairs + (value % 100) * 2;
+                value /= 100;
+                *--cursor = pair[1];
+                *--cursor = pair[0];
+            }
+            if (value >= 10) {
+                const char* pair = pairs + value * 2;
+                *--cursor = pair[1];
+                *--cursor = pair[0];
+            }
+            else {
+                *--cursor = static_cast<char>('0' + value);
+            }
+            out.append(cursor, digits + sizeof(digits) - cursor);
+        }
+
+        static void append_int(std::int64_t value, std::string& out) {
+            if (value < 0) {
+                out.push_back('-');
+                append_uint(0 - static_cast<std::uint64_t>(value), out);
+            }
+            else {
+                append_uint(static_cast<std::uint64_t>(value), out);
+            }
+        }
+
+        static void append_double(double value, std::string& out) {
+            char text[Double_length];
+            int length = std::snprintf(text, sizeof(text), "%g", value);
+            if (length > 0) out.append(text, static_cast<std::size_t>(length));
+        }
+
+        static const std::size_t Double_length = 32;
+
+        /**
+        * @brief        Write value as snprintf("%g") does - six significant digits, trailing zeros cut,
+        *               an exponent below 1e-4 or from 1e6 on - using nothing but arithmetic, so it may
+        *               run in a signal handler.
+        * @param text   Buffer of Double_length characters.
+        * @return       Number of characters written.
+        *
+        * Values up to 1e22 away from six digits are scaled by one exact power of ten, so their digits
+        * round as snprintf's do; beyond that the scaling takes several steps and, within a rounding
+        * error of halfway between two results, the last digit may differ.
+        */
+        static std::size_t format_double(double value, char* text) {
+            char* cursor = text;
+            if (value != value) {
+                std::memcpy(cursor, "nan", 3);
+                return 3;
+            }
+            if (std::signbit(value)) {
+                *cursor++ = '-';
+                value = -value;
+            }
+            if (value > 1.7976931348623157e308) {
+                std::memcpy(cursor, "inf", 3);
+                return cursor + 3 - text;
+            }
+            if (value == 0) {
+                *cursor++ = '0';
+                return cursor - text;
+            }
+
+            int binary;
+            std::frexp(value, &binary);
+            int exponent = static_cast<int>(std::floor((binary - 1) * 0.30102999566398120));
+            double error;
+            double scaled = scale_pow10(value, 5 - exponent, error);
+            while (scaled >= 999999.5) scaled = scale_pow10(value, 5 - ++exponent, error);
+            while (scaled < 99999.5) scaled = scale_pow10(value, 5 - --exponent, error);
+            std::uint64_t rounded = static_cast<std::uint64_t>(scaled);
+            double fraction = scaled - static_cast<double>(rounded);
+            // At a scaled half, the scaling error tells which side the value is on; only an exact half goes to even, as printf
+            if (fraction > 0.5 || (fraction == 0.5 && (error > 0 || (error == 0 && (rounded & 1) != 0)))) rounded++;
+            if (rounded > 999999) {
+                rounded /= 10;
+                exponent++;
+            }
+
+            char digits[6];
+            for (int i = 5; i >= 0; i--) {
+                digits[i] = static_cast<char>('0' + rounded % 10);
+                rounded /= 10;
+            }
+            int length = 6;
+            while (length > 1 && digits[length - 1] == '0') length--;
+
+            if (exponent < -4 || exponent >= 6) {
+                *cursor++ = digits[0];
+                if (length > 1) {
+                    *cursor++ = '.';
+                    for (int i = 1; i < length; i++) *cursor++ = digits[i];
+                }
+                *cursor++ = 'e';
+                *cursor++ = exponent < 0 ? '-' : '+';
+                int magnitude = exponent < 0 ? -exponent : exponent;
+                if (magnitude >= 100) *cursor++ = static_cast<char>('0' + magnitude / 100);
+                *cursor++ = static_cast<char>('0' + magnitude / 10 % 10);
+                *cursor++ = static_cast<char>('0' + magnitude % 10);
+            }
+            else if (exponent < 0) {
+                *cursor++ = '0';
+                *cursor++ = '.';
+                for (int i = exponent; i < -1; i++) *cursor++ = '0';
+                for (int i = 0; i < length; i++) *cursor++ = digits[i];
+            }
+            else {
+                for (int i = 0; i <= exponent; i++) *cursor++ = digits[i];
+                if (length > exponent + 1) {
+                    *cursor++ = '.';
+                    for (int i = exponent + 1; i < length; i++) *cursor++ = digits[i];
+                }
+            }
+            return cursor - text;
+        }
+
+        /**
+        * @brief        Append a CSV field, quoted when it contains a separator, quote or line break.
+        */
+        static void append_csv_field(const char* data, std::size_t length, std::string& out) {
+            bool quote = false;
+            for (std::size_t i = 0; i < length && !quote; i++)
+                quote = data[i] == ',' || data[i] == '"' || data[i] == '\r' || data[i] == '\n';
+            if (!quote) {
+                out.append(data, length);
+                return;
+            }
+            out.push_back('"');
+            for (std::size_t i = 0; i < length; i++) {
+                if (data[i] == '"') out.push_back('"');
+                out.push_back(data[i]);
+            }
+            out.push_back('"');
+        }
+
+        static void append_csv_field(const std::string& field, std::string& out) {
+            append_csv_field(field.data(), field.size(), out);
+        }
+
+        /**
+        * @brief        Append a quoted JSON string, escaping quotes, backslashes and control characters.
+        */
+        static void append_json_string(const char* data, std::size_t length, std::string& out) {
+            static const char hex[] = "0123456789abcdef";
+            out.push_back('"');
+            const char* segment = data;
+            const char* end = data + length;
+            for (const char* cursor = data; cursor < end; cursor++) {
+                unsigned char c = static_cast<unsigned char>(*cursor);
+                if (c >= 0x20 && c != '"' && c != '\\') continue;
+                out.append(segment, cursor - segment);
+                segment = cursor + 1;
+                switch (c) {
+                case '"':  out.append("\\\""); break;
+                case '\\': out.append("\\\\"); break;
+                case '\n': out.append("\\n"); break;
+                case '\r': out.append("\\r"); break;
+                case '\t': out.append("\\t"); break;
+                default:
+                    out.append("\\u00");
+                    out.push_back(hex[c >> 4]);
+                    out.push_back(hex[c & 0xf]);
+                }
+            }
+            out.append(segment, end - segment);
+            out.push_back('"');
+        }
+
+        static void append_json_string(const std::string& text, std::string& out) {
+            append_json_string(text.data(), text.size(), out);
+        }
+
+        /**
+        * @brief        Append a JSON number that reads back as the same double; null for NaN and infinities.
+        *
+        * Whole numbers take the integer path; others try 15 significant digits and fall back to 17
+        * only when 15 do not round-trip.
+        */
+        static void append_json_double(double value, std::string& out) {
+            if (!std::isfinite(value)) {
+                out.append("null");
+                return;
+            }
+            if (value > -1e15 && value < 1e15 && value == static_cast<double>(static_cast<std::int64_t>(value))) {
+                append_int(static_cast<std::int64_t>(value), out);
+                return;
+            }
+            char text[32];
+            int length = std::snprintf(text, sizeof(text), "%.15g", value);
+            if (std::strtod(text, nullptr) != value) length = std::snprintf(text, sizeof(text), "%.17g", value);
+            if (length > 0) out.append(text, static_cast<std::size_t>(length));
+        }
+
+        /**
+        * @brief        Append one encoded argument as a JSON value and return the position of the next one,
+        *               or nullptr if it runs past end.
+        *
+        * Numbers and booleans keep their type; characters and text become strings. The keys of a
+        * field are skipped; the caller writes them as the JSON member name.
+        */
+        static const unsigned char* append_json_arg(const unsigned char* data, const unsigned char* end, std::string& out) {
+            while (data && data < end && static_cast<Type>(*data) == Type::Field) data = skip_text(data + 1, end);
+            if (!data || data >= end) return nullptr;
+            Type type = static_cast<Type>(*data++);
+            if (type != Type::String && !fits(data, end, type == Type::Bool || type == Type::Char ? 1 : 8)) return nullptr;
+            switch (type) {
+            case Type::Int: {
+                std::int64_t value;
+                std::memcpy(&value, data, sizeof(value));
+                append_int(value, out);
+                return data + sizeof(value);
+            }
+            case Type::Uint: {
+                std::uint64_t value;
+                std::memcpy(&value, data, sizeof(value));
+                append_uint(value, out);
+                return data + sizeof(value);
+            }
+            case Type::Double: {
+                double value;
+                std::memcpy(&value, data, sizeof(value));
+                append_json_double(value, out);
+                return data + sizeof(value);
+            }
+            case Type::Bool:
+                out.append(*data ? "true" : "false");
+                return data + 1;
+            case Type::Char:
+                append_json_string(reinterpret_cast<const char*>(data), 1, out);
+                return data + 1;
+            case Type::String: {
+                std::uint32_t length;
+                if (!take_length(data, end, length)) return nullptr;
+                append_json_string(reinterpret_cast<const char*>(data), length, out);
+                return data + length;
+            }
+            case Type::Field:
+                break;
+            }
+            return nullptr;
+        }
+
+    private:
+        /**
+        * @brief        value times ten to the power, from exact powers of ten up to 1e22.
+        * @param error  Set to a number with the sign of the exact result minus the returned one, for the last step.
+        */
+        static double scale_pow10(double value, int power, double& error) {
+            static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+            for (; power > 22; power -= 22) value *= 1e22;
+            for (; power < -22; power += 22) value /= 1e22;
+            if (power >= 0) {
+                double result = value * powers[power];
+                error = std::fma(value, powers[power], -result);
+                return result;
+            }
+            double result = value / powers[-power];
+            error = std::fma(-result, powers[-power], value);
+            return result;
+        }
+
+        /**
+        * @brief Text of the rendered arguments of the last size_of() call, in argument order.
+        *
+        * lengths holds the size reserved for each text. A value whose operator<< logs on the same
+        * thread may reuse the list before encode() reads it; encode() then still writes exactly the
+        * reserved length.
+        */
+        struct Scratch {
+            std::vector<std::string> texts;
+            std::vector<std::size_t> lengths;
+            std::size_t sized = 0;
+            std::size_t encoded = 0;
+        };
+
+        static Scratch& scratch() {
+            static thread_local Scratch texts;
+            return texts;
+        }
+
+        static std::size_t sizes() { return 0; }
+
+        template <typename Arg, typename... Args>
+        static std::size_t sizes(const Arg& arg, const Args&... args) {
+            return arg_size(arg) + sizes(args...);
+        }
+
+        static unsigned char* put_all(unsigned char* data) { return data; }
+
+        template <typename Arg, typename... Args>
+        static unsigned char* put_all(unsigned char* data, const Arg& arg, const Args&... args) {
+            return put_all(put(data, arg), args...);
+        }
+
+        /**
+        * @brief        Position of the first argument at or after data that is not a field, or nullptr
+        *               if a field runs past end.
+        */
+        static const unsigned char* skip_fields(const unsigned char* data, const unsigned char* end, bool& has_fields) {
+            while (data && data < end && static_cast<Type>(*data) == Type::Field) {
+                has_fields = true;
+                data = skip_arg(data, end);
+            }
+            return data;
+        }
+
+        static bool fits(const unsigned char* data, const unsigned char* end, std::size_t size) {
+            return static_cast<std::size_t>(end - data) >= size;
+        }
+
+        /**
+        * @brief        Read the 32-bit length at data and move data past it.
+        * @return       False if the length or the bytes it counts run past end.
+        */
+        static bool take_length(const unsigned char*& data, const unsigned char* end, std::uint32_t& length) {
+            if (!fits(data, end, sizeof(length))) return false;
+            std::memcpy(&length, data, sizeof(length));
+            data += sizeof(length);
+            return fits(data, end, length);
+        }
+
+        /**
+        * @brief        Position after the length-prefixed text at data, or nullptr if it runs past end.
+        */
+        static const unsigned char* skip_text(const unsigned char* data, const unsigned char* end) {
+            std::uint32_t length;
+            return take_length(data, end, length) ? data + length : nullptr;
+        }
+
+        static std::size_t arg_size(bool) { return 2; }
+        static std::size_t arg_size(char) { return 2; }
+        static std::size_t arg_size(signed char) { return 9; }
+        static std::size_t arg_size(unsigned char) { return 9; }
+        static std::size_t arg_size(short) { return 9; }
+        static std::size_t arg_size(unsigned short) { return 9; }
+        static std::size_t arg_size(int) { return 9; }
+        static std::size_t arg_size(unsigned int) { return 9; }
+        static std::size_t arg_size(long) { return 9; }
+        static std::size_t arg_size(unsigned long) { return 9; }
+        static std::size_t arg_size(long long) { return 9; }
+        static std::size_t arg_size(unsigned long long) { return 9; }
+        static std::size_t arg_size(float) { return 9; }
+        static std::size_t arg_size(double) { return 9; }
+        static std::size_t arg_size(long double) { return 9; }
+        static std::size_t arg_size(const char* value) { return 5 + (value ? std::strlen(value) : 0); }
+        static std::size_t arg_size(char* value) { return arg_size(static_cast<const char*>(value)); }
+        static std::size_t arg_size(const std::string& value) { return 5 + value.size(); }
+
+        template <typename T>
+        static std::size_t arg_size(const T& value) {
+            std::string text = to_text(value);
+            Scratch& texts = scratch();
+            std::size_t index = texts.sized++;
+            if (index == texts.texts.size()) {
+                texts.texts.emplace_back();
+                texts.lengths.push_back(0);
+            }
+            texts.texts[index].swap(text);
+            texts.lengths[index] = texts.texts[index].size();
+            return 5 + texts.lengths[index];
+        }
+
+        template <typename T>
+        static std::size_t arg_size(const Field_arg<T>& value) {
+            return 5 + (value.key ? std::strlen(value.key) : 0) + arg_size(value.value);
+        }
+
+        static unsigned char* put_type(unsigned char* data, Type type) {
+            *data = static_cast<unsigned char>(type);
+            return data + 1;
+        }
+
+        template <typename T>
+        static unsigned char* put_value(unsigned char* data, Type type, T value) {
+            data = put_type(data, type);
+            std::memcpy(data, &value, sizeof(value));
+            return data + sizeof(value);
+        }
+
+        static unsigned char* put_length(unsigned char* data, std::size_t length) {
+            std::uint32_t size = static_cast<std::uint32_t>(length);
+            std::memcpy(data, &size, sizeof(size));
+            return data + sizeof(size);
+        }
+
+        static unsigned char* put_text(unsigned char* data, const char* text, std::size_t length, Type type = Type::String) {
+            data = put_length(put_type(data, type), length);
+            if (length) std::memcpy(data, text, length);
+            return data + length;
+        }
+
+        static unsigned char* put(unsigned char* data, bool value) {
+            data = put_type(data, Type::Bool);
+            *data = value ? 1 : 0;
+            return data + 1;
+        }
+
+        static unsigned char* put(unsigned char* data, char value) {
+            data = put_type(data, Type::Char);
+            *data = static_cast<unsigned char>(value);
+            return data + 1;
+        }
+
+        static unsigned char* put(unsigned char* data, signed char value) { return put_value(data, Type::Int, static_cast<std::int64_t>(value)); }
+        static unsigned char* put(unsigned char* data, unsigned char value) { return put_value(data, Type::Uint, static_cast<std::uint64_t>(value)); }
+        static unsigned char* put(unsigned char* data, short value) { return put_value(data, Type::Int, static_cast<std::int64_t>(value)); }
+        static unsigned char* put(unsigned char* data, unsigned short value) { return put_value(data, Type::Uint, static_cast<std::uint64_t>(value)); }
+        static unsigned char* put(unsigned char* data, int value) { return put_value(data, Type::Int, static_cast<std::int64_t>(value)); }
+        static unsigned char* put(unsigned char* data, unsigned int value) { return put_value(data, Type::Uint, static_cast<std::uint64_t>(value)); }
+        static unsigned char* put(unsigned char* data, long value) { return put_value(data, Type::Int, static_cast<std::int64_t>(value)); }
+        static unsigned char* put(unsigned char* data, unsigned long value) { return put_value(data, Type::Uint, static_cast<std::uint64_t>(value)); }
+        static unsigned char* put(unsigned char* data, long long value) { return put_value(data, Type::Int, static_cast<std::int64_t>(value)); }
+        static unsigned char* put(unsigned char* data, unsigned long long value) { return put_value(data, Type::Uint, static_cast<std::uint64_t>(value)); }
+        static unsigned char* put(unsigned char* data, float value) { return put_value(data, Type::Double, static_cast<double>(value)); }
+        static unsigned char* put(unsigned char* data, double value) { return put_value(data, Type::Double, value); }
+        static unsigned char* put(unsigned char* data, long double value) { return put_value(data, Type::Double, static_cast<double>(value)); }
+
+        static unsigned char* put(unsigned char* data, const char* value) {
+            return put_text(data, value ? value : "", value ? std::strlen(value) : 0);
+        }
+
+        static unsigned char* put(unsigned char* data, char* value) {
+            return put(data, static_cast<const char*>(value));
+        }
+
+        static unsigned char* put(unsigned char* data, const std::string& value) {
+            return put_text(data, value.data(), value.size());
+        }
+
+        /**
+        * @brief        Copy the text size_of() rendered for value, cut or space-padded to the length reserved for it.
+        */
+        template <typename T>
+        static unsigned char* put(unsigned char* data, const T& value) {
+            Scratch& texts = scratch();
+            std::size_t index = texts.encoded++;
+            if (index >= texts.sized) {
+                std::string text = to_text(value);
+                return put_text(data, text.data(), text.size());
+            }
+
+            const std::string& text = texts.texts[index];
+            std::size_t length = texts.lengths[index];
+            std::size_t copied = text.size() < length ? text.size() : length;
+            data = put_length(put_type(data, Type::String), length);
+            if (copied) std::memcpy(data, text.data(), copied);
+            std::memset(data + copied, ' ', length - copied);
+            return data + length;
+        }
+
+        template <typename T>
+        static unsigned char* put(unsigned char* data, const Field_arg<T>& value) {
+            data = put_text(data, value.key ? value.key : "", value.key ? std::strlen(value.key) : 0, Type::Field);
+            return put(data, value.value);
+        }
+
+        template <typename T>
+        static std::string to_text(const T& value) {
+            std::stringstream strm;
+            strm << value;
+            return strm.str();
+        }
+};
+
+#endif // LOGGER_ARGS_HH
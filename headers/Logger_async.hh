@@ -2,6 +2,7 @@
 #define LOGGER_ASYNC_HH
 
 #include <thread>
+#include <chrono>
 #include <ctime>
 #include <cassert>
 
@@ -12,12 +13,22 @@
 
 #include <unordered_map>
 #include <vector>
-#include <deque>
 
 #include <memory>
+#include <future>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 
+#include "Logger_args.hh"
+#include "Logger_binary.hh"
+#include "Logger_crash.hh"
+#include "Logger_file.hh"
+#include "Logger_limit.hh"
+#include "Logger_ring.hh"
+#include "Logger_rotate.hh"
+#include "Logger_time.hh"
+
 using API_command = std::string;
 
 /**
@@ -25,7 +36,8 @@ using API_command = std::string;
  *
  * The logger supports multiple threads and can output to multiple outputs, such as the console or a file.
  * The logger can also output user-defined types by using operator<< overloads.
- * The log messages are produced asynchronously by using a daemon thread.
+ * The log messages are produced asynchronously by using a daemon thread, which hands them to one
+ * lane thread per output, so a slow output only delays its own messages.
  *
  * Example:
  * 
@@ -34,13 +46,24 @@ using API_command = std::string;
  *   std::thread::id thread_id = std::this_thread::get_id();
  *   logger.add_output(thread_id, Logger_async::Log_type::Console);
  *   logger.add_output(thread_id, Logger_async::Log_type::File, "log1_async.txt", false);
+ *   logger.set_thread_name(thread_id, "worker-7");                            // "[worker-7]" instead of the id
  *   logger.add_log(thread_id, "Message from thread 1");
+ *   logger.add_log(thread_id, "Request {} took {} us", request_id, elapsed_us);
+ *   logger.add_log(thread_id, Logger_async::LogLevel::WARNING, "Disk {} is {}% full", disk, percent);
+ *   logger.add_log(thread_id, Logger_async::LogLevel::INFO, "Request done",
+ *                  Logger_args::field("latency_us", elapsed_us), Logger_args::field("user", user_id));
+ *   LOGGER_ASYNC_DEBUG(logger, thread_id, "Cache state {}", dump_cache());    // compiled out with NDEBUG
+ *   LOGGER_ASYNC_PER_SECOND(logger, Logger_async::LogLevel::ERROR, thread_id, 10, "Poll failed: {}", err); // at most 10/s
+ *   logger.flush();                                                           // everything above is written
  * @endcode
  */
 
 class Logger_async {
+    private:
+        struct Batch_item;
+
     public:
-        Logger_async();
+        explicit Logger_async(std::size_t ring_capacity = 1024);
         ~Logger_async();
 
         /**
@@ -49,70 +72,910 @@ class Logger_async {
         enum class Log_type {
             Console,
             FileLog,
-            CSVLog
+            CSVLog,
+            BinaryLog,
+            MmapLog,
+            JsonLog
+        };
+
+        /**
+        * @brief Enum for severity of a message. Messages below the level set with set_log_level() are not queued.
+        */
+        enum class LogLevel {
+            TRACE,
+            DEBUG,
+            INFO,
+            WARNING,
+            ERROR,
+            FATAL
+        };
+
+        /**
+        * @brief Enum for when an output's lane flushes the output it writes to.
+        */
+        enum class Flush_policy {
+            Per_batch,      ///< Whenever the lane has written everything queued for it.
+            Interval,       ///< At most once every N milliseconds.
+            Bytes           ///< Once N bytes are pending, or when the lane runs out of work.
+        };
+
+        /**
+        * @brief Enum for what a producer does when its queue is full.
+        *
+        * Messages that are not queued are counted, and the counts are logged to the producing
+        * thread's outputs about once a second.
+        */
+        enum class Overload_policy {
+            Block,          ///< Wait until the daemon makes room (default, nothing is lost).
+            Drop_newest,    ///< Discard the new message; add_log() returns false.
+            Drop_oldest,    ///< Discard the oldest queued message of the thread to make room.
+            Spill           ///< Write the message as a text line to a spill file on the calling thread.
+        };
+
+        /**
+         * @brief A log message as it is handed to the outputs.
+         *
+         * The daemon builds the line of a message once, and only if one of its outputs needs text
+         * (Output::needs_line()), so outputs that keep the raw format and arguments (Binary_Log) cost
+         * no formatting. Text asked for anyway is built on the lane's thread, once per entry.
+         */
+        class Log_entry {
+            public:
+                std::uint64_t tick;                 ///< Logger_clock reading taken when the message was logged.
+                std::thread::id thread_id;
+                const char* format;                 ///< Static "{}" format, or nullptr for a plain text message.
+                const unsigned char* args;          ///< Arguments of format encoded by Logger_args.
+                std::uint32_t args_size;
+                LogLevel level;
+                bool has_level;                     ///< False for messages logged without a level, which count as INFO.
+
+                std::int64_t wall_ns() const;
+                std::size_t format_time(char* out) const;
+                const std::string& thread_text() const;
+                const std::string& message() const;
+                const std::string& line() const;
+
+            private:
+                friend class Logger_async;
+                Log_entry(const Batch_item& item, Logger_time_formatter& time_formatter, std::string& message_buffer, std::string& line_buffer);
+
+                const Batch_item& item_;
+                Logger_time_formatter& time_formatter_;
+                std::string& message_;              ///< Buffers of the lane, reused by every entry it writes.
+                std::string& line_;
+                mutable bool has_message_;
+                mutable bool has_line_;
         };
 
         /**
          * @brief Based output interface for log messages.
+         *
+         * write_log() only queues a line; nothing has to reach the device before flush() is called.
+         * Outputs that want the fields of a message instead of the finished line override write_record().
+         * Every output is written by its own lane thread, one call at a time.
+         *
+         * crash_flush() is called from a fatal signal handler (see enable_crash_flush()), on whatever
+         * thread crashed, once the output's lane has stopped writing to it. It writes what the output
+         * has buffered with async-signal-safe calls only - no allocation, no locks, no stream library.
+         * Outputs that buffer nothing keep the default.
          */
         class Output {
             public:
+                /**
+                * @brief Counters of the output's lane.
+                */
+                struct Stats {
+                    std::uint64_t written;          ///< Messages handed to the output.
+                    std::uint64_t dropped;          ///< Messages discarded because the lane's backlog was full and their level does not block.
+                    std::size_t backlog;            ///< Messages queued for the output now.
+                    std::size_t max_backlog;        ///< Largest backlog seen.
+                    std::uint64_t bytes;            ///< Text handed to the output; binary records count their arguments.
+                    std::uint64_t write_ns;         ///< Time spent in write_record() and flush().
+                };
+
                 virtual ~Output() = default;
                 virtual void write_log(const std::string& message) = 0;
+                virtual void write_record(const Log_entry& entry) { write_log(entry.line()); }
+                virtual void flush() {}
+                virtual void crash_flush() {}
+                virtual bool needs_line() const { return true; }
+                Stats stats() const;
+
+            private:
+                friend class Logger_async;
+                std::atomic<std::uint64_t> written_{0};
+                std::atomic<std::uint64_t> dropped_{0};
+                std::atomic<std::size_t> backlog_{0};
+                std::atomic<std::size_t> max_backlog_{0};
+                std::atomic<std::uint64_t> bytes_{0};
+                std::atomic<std::uint64_t> write_ns_{0};
+                std::atomic<bool> full_{false};         ///< The lane holds lane capacity messages or more.
+                std::mutex room_mutex_;
+                std::condition_variable room_;          ///< Wakes producers waiting for full_ to clear.
         };
 
         /**
-         * @brief Output to the console.
+         * @brief Output to the console, written straight to the stdout and stderr descriptors.
+         *
+         * Messages at stderr_level or above go to stderr, all others to stdout. A stream connected to
+         * a terminal is line-buffered - each line is written as it comes. A pipe or file is
+         * block-buffered: lines are collected and written Block_size bytes at a time, and at flush().
          */
         class Console_Log : public Output {
             public:
+                static const std::size_t Block_size = 64 * 1024;
+
+                explicit Console_Log(LogLevel stderr_level = LogLevel::ERROR);
+                ~Console_Log();
                 void write_log(const std::string& message) override;
+                void write_record(const Log_entry& entry) override;
+                void flush() override;
+                void crash_flush() override;
+
+            private:
+                struct Stream {
+                    int fd;
+                    bool tty;
+                    std::string buffer;
+                };
+
+                static void append(Stream& stream, const std::string& line);
+                static void write_out(Stream& stream);
+
+                Stream out_;
+                Stream err_;
+                LogLevel stderr_level_;
         };
 
         /**
         * @brief Output to a text/log file.
+        *
+        * The backend picks how batches reach the file (see Logger_file); add_output() uses the
+        * std::ofstream one, other backends are set up with add_output(thread_id, std::make_shared<File_Log>(...)).
         */
         class File_Log : public Output {
             public:
-                File_Log(std::string& filename, bool append_ = false);
-                ~File_Log();
+                File_Log(std::string& filename, bool append_ = false, Logger_file::Backend backend = Logger_file::Backend::Stream,
+                         const Logger_rotation::Policy& rotation = Logger_rotation::Policy());
                 void write_log(const std::string& message) override;
+                void flush() override;
+                void crash_flush() override;
+                Logger_file::Stats write_stats() const { return file_->stats(); }
+                Logger_rotation& rotation() { return rotation_; }
             private:
-                std::ofstream file_;
+                void rotate();
+                void report_rotation();
+
+                std::string path_;
+                Logger_file::Backend backend_;
+                std::unique_ptr<Logger_file> file_;
+                Logger_rotation rotation_;
         };
 
+        /**
+        * @brief Output to a CSV file with a "time,thread,level,message" row per message.
+        *
+        * Rows are written straight from the fields of the entry, so the daemon builds no line for
+        * this output. The level is empty for messages logged without one.
+        */
         class CSV_Log : public Output {
             public:
-                CSV_Log(std::string& filename, bool append_ = false);
-                ~CSV_Log();
+                CSV_Log(std::string& filename, bool append_ = false, Logger_file::Backend backend = Logger_file::Backend::Stream);
                 void write_log(const std::string& message) override;
+                void write_record(const Log_entry& entry) override;
+                void flush() override;
+                void crash_flush() override;
+                bool needs_line() const override { return false; }
+                Logger_file::Stats write_stats() const { return file_.stats(); }
 
             private:
-                std::vector<std::string> split(const std::string& message, char delimiter);
+                Logger_file file_;
+                std::string row_;
+        };
+
+        /**
+        * @brief Output to a JSON Lines file with one object per message.
+        *
+        * Objects have the members "ts_ns" (wall-clock ns since the Unix epoch), "time", "thread",
+        * "level" (left out for messages logged without one) and "message", followed by the message's
+        * key-value fields with their types kept. They are written from the encoded arguments into a
+        * reused buffer, so the daemon builds no line for this output.
+        */
+        class Json_Log : public Output {
+            public:
+                Json_Log(std::string& filename, bool append_ = false, Logger_file::Backend backend = Logger_file::Backend::Stream);
+                void write_log(const std::string& message) override;
+                void write_record(const Log_entry& entry) override;
+                void flush() override;
+                void crash_flush() override;
+                bool needs_line() const override { return false; }
+                Logger_file::Stats write_stats() const { return file_.stats(); }
+
+            private:
+                Logger_file file_;
+                std::string row_;
+                std::string message_;
+        };
+
+        /**
+        * @brief Output to a compact binary file - format ID, timestamp, thread ID and raw arguments per message.
+        *
+        * Nothing is rendered to text; every format string and thread name is stored once in the file and
+        * referred to by ID afterwards. Logger_decode turns the file back into text or CSV.
+        */
+        class Binary_Log : public Output {
+            public:
+                Binary_Log(std::string& filename, bool append_ = false);
+                ~Binary_Log();
+                void write_log(const std::string& message) override;
+                void write_record(const Log_entry& entry) override;
+                void flush() override;
+                void crash_flush() override;
+                bool needs_line() const override { return false; }
+
+            private:
+                std::uint32_t format_id(const char* format);
+                std::uint32_t thread_key(std::thread::id thread_id, const Log_entry* entry);
+                void put_definition(unsigned char tag, std::uint32_t id, const char* text, std::size_t length);
+                static unsigned char level_byte(LogLevel level, bool has_level);
+                void put_record(std::uint32_t format, std::int64_t wall_ns, std::uint32_t thread, unsigned char level, const unsigned char* args, std::uint32_t args_size);
+                template <typename T> void put(T value);
+
+                std::string path_;
                 std::ofstream file_;
+                std::string buffer_;
+                std::string scratch_;
+                std::unordered_map<const char*, std::uint32_t> formats_;
+                std::unordered_map<std::thread::id, std::uint32_t> threads_;
+        };
+
+        /**
+        * @brief Output to a text/log file through a memory-mapped window that grows a segment at a time.
+        *
+        * Lines are copied into the mapping with memcpy; the file is extended by segment_size bytes
+        * whenever the window is full and cut back to the written length when the output is closed.
+        * A background thread writes dirty pages back (msync / FlushViewOfFile) about once a second, so
+        * the daemon never waits for the disk; the lane waits for it only when it moves to the next
+        * segment during a write-back. While the output is open the file ends in zero bytes up to the segment end.
+        * Lines in the mapping reach the file even if the process crashes, so there is no crash_flush().
+        */
+        class Mmap_Log : public Output {
+            public:
+                Mmap_Log(std::string& filename, bool append_ = false, std::size_t segment_size = 16 << 20);
+                ~Mmap_Log();
+                void write_log(const std::string& message) override;
+
+            private:
+                void append(const char* data, std::size_t length);
+                bool map_segment(std::uint64_t offset);
+                void unmap_segment();
+                void sync_thread();
+
+                std::intptr_t file_;                    ///< File descriptor (POSIX) or HANDLE (Windows).
+                std::intptr_t mapping_;                 ///< File mapping HANDLE (Windows only).
+                char* view_;
+                std::uint64_t view_offset_;
+                std::size_t view_size_;
+                std::size_t segment_size_;
+                std::atomic<std::uint64_t> length_;     ///< Bytes written; only the lane stores it.
+
+                std::mutex map_mutex_;
+                std::condition_variable sync_condition_;
+                std::uint64_t synced_;                  ///< Bytes known to be written back.
+                bool stop_sync_;
+                std::thread sync_thread_;
+        };
+
+        static const std::size_t Latency_buckets = 24;
+        static const std::size_t Default_lane_capacity = 1 << 16;
+
+        /**
+        * @brief Counters of the logger, read with stats() while it runs.
+        *
+        * Latencies are counted in power-of-two buckets of microseconds: bucket 0 holds waits under
+        * 1 us, bucket i waits of 2^(i-1) to 2^i us, and the last bucket everything longer. The
+        * counters are read one by one, so under load they may be a moment apart from each other.
+        */
+        struct Stats {
+            double seconds;                                 ///< Time since the logger was created, to turn counts into rates.
+            std::uint64_t enqueued;                         ///< Records queued in the producer rings so far.
+            std::uint64_t dropped;                          ///< Records lost to the Drop_newest and Drop_oldest overload policies.
+            std::uint64_t spilled;                          ///< Records written to the spill file.
+            std::uint64_t suppressed;                       ///< Calls held back by rate limits and reported so far.
+            std::uint64_t folded;                           ///< Repeated messages counted instead of written by compaction.
+            std::size_t queue_depth;                        ///< Records in the producer rings now.
+            std::size_t max_queue_depth;                    ///< Most records the daemon has found queued at once.
+            std::uint64_t queue_latency[Latency_buckets];   ///< From add_log() until the daemon took the record.
+            std::uint64_t write_latency[Latency_buckets];   ///< From add_log() until a lane had written the record, per output.
+            std::vector<std::pair<const Output*, Output::Stats>> outputs;   ///< Every output a thread is routed to.
+
+            static std::uint64_t percentile(const std::uint64_t (&buckets)[Latency_buckets], double fraction);
         };
 
         void add_output(std::thread::id thread_id, Log_type _log = Log_type::Console, std::string path = "", bool append_ = true);
+        void add_output(std::thread::id thread_id, std::shared_ptr<Output> output);
         void remove_thread_ouput(std::thread::id thread_id);
-        bool add_log(std::thread::id thread_id, std::string message);
+        bool add_log(std::thread::id thread_id, const char* message);
+        bool add_log(std::thread::id thread_id, const std::string& message);
+        bool add_log(std::thread::id thread_id, LogLevel level, const std::string& message);
+        template <std::size_t N, typename Arg, typename... Args>
+        bool add_log(std::thread::id thread_id, const char (&format)[N], const Arg& arg, const Args&... args);
+        template <std::size_t N, typename... Args>
+        bool add_log(std::thread::id thread_id, LogLevel level, const char (&format)[N], const Args&... args);
+        template <std::size_t N, typename... Args>
+        bool add_log(std::thread::id thread_id, Logger_limit& limit, LogLevel level, const char (&format)[N], const Args&... args);
+        void set_log_level(LogLevel level);
+        LogLevel log_level() const;
+        bool should_log(LogLevel level) const { return level >= log_level_.load(std::memory_order_relaxed); }
+        void set_flush_policy(Flush_policy policy, std::size_t value = 0);
+        void set_overload_policy(Overload_policy policy, std::string spill_path = "");
+        void set_overload_policy(LogLevel level, Overload_policy policy, std::string spill_path = "");
+        void set_lane_capacity(std::size_t capacity);
+        void set_compaction(bool enabled);
+        void set_thread_name(std::thread::id thread_id, std::string name);
+        void flush();
+        void flush(std::thread::id thread_id);
+        std::future<void> flush_async();
+        std::future<void> flush_async(std::thread::id thread_id);
+        bool enable_crash_flush(std::string path = "");
+        void disable_crash_flush();
+        Stats stats();
+        void set_stats_report(std::thread::id thread_id, std::chrono::milliseconds interval);
 
     private:
+        static const std::size_t Inline_args = 64;
+        static const std::size_t Record_reserve = 128;
+        static const std::size_t Item_reserve = 256;
+        static const std::size_t Crash_render_size = 16 * 1024;
+        static const std::size_t Level_count = 6;
+        static const int Wait_spins = 64;          ///< Checks made before a thread waiting on a ring goes to sleep.
+        static const std::size_t Crash_slots = 256;    ///< Rings, lanes and batches crash_flush() can reach, each.
+        static const int Crash_naps = 200;         ///< Waits of about 1 ms crash_flush() spends at most on threads it has to stop.
+
+        static const std::uint32_t No_slot = static_cast<std::uint32_t>(-1);
+
+        /**
+         * @brief Outputs and text of one thread.
+         */
+        struct Route {
+            std::thread::id thread_id;                      ///< Owner of the slot; records of an earlier owner no longer match.
+            std::vector<std::shared_ptr<Output>> outputs;
+            std::shared_ptr<const std::string> text;        ///< Id or name of the thread; batch items hold their own reference.
+        };
+
+        /**
+         * @brief Outputs of every registered thread. Published tables are never modified - see acquire_routes().
+         *
+         * A thread gets a dense slot when its first output is added and gives it up when its outputs
+         * are removed; the next new thread reuses it. Records carry the slot, so the daemon reaches a
+         * route by index, not by hashing, and checks the owner's id before using it.
+         */
+        struct Routing_table {
+            std::unordered_map<std::thread::id, std::uint32_t> slots;
+            std::vector<Route> routes;                      ///< Indexed by slot.
+        };
+
+        /**
+         * @brief One queued log message.
+         *
+         * Either message holds finished text (format is nullptr), or format points to a static
+         * "{}"-style format whose arguments are encoded by Logger_args - in args when they fit,
+         * otherwise in the bytes of message.
+         */
+        struct Record {
+            std::thread::id thread_id;
+            std::uint32_t slot;                 ///< Route of thread_id, or No_slot.
+            std::uint64_t tick;                 ///< Logger_clock reading taken when the message was logged.
+            const char* format;
+            std::uint32_t args_size;
+            LogLevel level;
+            bool has_level;
+            unsigned char args[Inline_args];
+            std::string message;
+        };
+
+        /**
+         * @brief A record taken over from a ring by the daemon, with the text its outputs need.
+         *
+         * The daemon fills every field before setting unwritten, and changes none of them again until
+         * the batch comes back from the pool, so crash_flush() may read an item whose count is not 0.
+         */
+        struct Batch_item {
+            Batch_item() : wall_ns(0), has_line(false), unwritten(0) {}
+            Batch_item(Batch_item&& other)
+                : record(std::move(other.record)), wall_ns(other.wall_ns), thread_text(std::move(other.thread_text)),
+                  message(std::move(other.message)), line(std::move(other.line)), has_line(other.has_line),
+                  unwritten(other.unwritten.load(std::memory_order_relaxed)) {}
+
+            Record record;
+            std::int64_t wall_ns;
+            std::shared_ptr<const std::string> thread_text;     ///< Text of the thread's route; kept alive while the item is.
+            std::string message;                ///< Rendered text of a formatted record, if has_line.
+            std::string line;
+            bool has_line;
+            mutable std::atomic<std::uint32_t> unwritten;   ///< Lanes that have neither written nor dropped the item yet.
+        };
+
+        /**
+         * @brief Records of one daemon pass, shared read-only by every lane they are routed to.
+         *
+         * Batches are pooled - the last lane to let go of one hands it back to the logger, strings and all.
+         * The count of holders lives in the batch, so handing one out allocates nothing.
+         */
+        struct Batch {
+            std::vector<Batch_item> items;
+            std::size_t size;
+            std::atomic<std::size_t> holders;   ///< Lanes that still read the batch, plus the daemon while it dispatches.
+            std::atomic<std::size_t> published; ///< Items crash_flush() may read.
+            std::atomic<bool> growing;          ///< The daemon is moving items to a larger array.
+        };
+
+        /**
+         * @brief Completion of one flush() call, shared by the daemon and the lanes it waits for.
+         */
+        struct Flush_barrier {
+            std::promise<void> done;
+            std::atomic<std::size_t> waiting;   ///< Lanes that have not flushed yet, plus the daemon.
+
+            void arrive() {
+                if (waiting.fetch_sub(1, std::memory_order_acq_rel) == 1) done.set_value();
+            }
+        };
+
+        /**
+         * @brief A flush() call waiting for the daemon - for every output, or for the outputs of one thread.
+         */
+        struct Flush_request {
+            std::shared_ptr<Flush_barrier> barrier;
+            std::thread::id thread_id;
+            bool all_outputs;
+        };
+
+        /**
+         * @brief Worker that writes the records routed to one output, so a slow output only holds itself up.
+         *
+         * The daemon queues (batch, item indices) pairs; the lane's thread writes them and flushes by
+         * the logger's flush policy. Past the logger's lane capacity, messages whose level drops on
+         * overload are dropped and reported in the output itself; the others are still queued, and the
+         * output is marked full so that the threads routed to it block or spill in add_log() until
+         * the lane is back under capacity. The daemon never waits for a lane.
+         */
+        class Lane {
+            public:
+                static const std::size_t Work_reserve = 64;
+
+                Lane(Logger_async& logger, const std::shared_ptr<Output>& output);
+                ~Lane();
+
+                const Output* output() const { return output_.get(); }
+                bool submit(Batch* batch);
+                bool submit_barrier(const std::shared_ptr<Flush_barrier>& barrier);
+                void close();
+                bool reopen();
+                bool finished();
+                void crash_flush(int& naps);
+
+                std::vector<std::uint32_t> staging;     ///< Items of the current pass - daemon only.
+
+            private:
+                struct Work {
+                    Batch* batch;
+                    std::vector<std::uint32_t> indices;
+                    std::shared_ptr<Flush_barrier> barrier;     ///< Set instead of batch for a flush() barrier.
+                };
+
+                void run();
+                void enter_output();
+                void leave_output();
+                bool flush_due(bool idle);
+                void flush();
+                void count_latency(const Batch& batch, const std::vector<std::uint32_t>& indices, std::uint64_t end);
+                void report_dropped();
+                bool must_keep(const Record& record) const;
+
+                Logger_async& logger_;
+                std::shared_ptr<Output> output_;
+
+                std::mutex mutex_;
+                std::condition_variable condition_;
+                std::vector<Work> queue_;                   ///< Swapped with work_ whole, so neither allocates once grown.
+                std::vector<Work> work_;
+                std::atomic<bool> in_output_;               ///< The thread is calling the output; crash_flush() waits for it to leave.
+                std::vector<std::vector<std::uint32_t>> spare_indices_;
+                std::size_t queued_;
+                bool sleeping_;
+                bool closing_;
+                bool finished_;
+
+                Logger_time_formatter time_formatter_;
+                std::string entry_message_;
+                std::string entry_line_;
+                bool dirty_;
+                std::size_t pending_bytes_;
+                std::uint64_t reported_dropped_;
+                std::chrono::steady_clock::time_point last_flush_;
+                std::thread thread_;
+        };
+
+        /**
+         * @brief The last message of a thread, kept by the daemon to fold identical messages that follow it.
+         */
+        struct Repeat {
+            bool valid = false;
+            std::uint64_t hash = 0;
+            const char* format = nullptr;
+            LogLevel level = LogLevel::INFO;
+            bool has_level = false;
+            std::string bytes;                  ///< Text, or encoded arguments, of the message.
+            std::uint64_t count = 0;            ///< Copies folded since the message or the last summary was written.
+            std::uint64_t first_tick = 0;
+            std::uint64_t last_tick = 0;
+        };
+
+        /**
+         * @brief Per-thread producer state - a private ring only its owning thread pushes into.
+         *
+         * Rings are owned by the logger and by the thread-local cache of the producing thread. When
+         * that thread exits the ring is marked orphaned and handed to the next thread that registers.
+         * Every slot starts with Record_reserve bytes for text and large arguments, which it keeps
+         * trading with the daemon's batch items, so short of a longer message nothing is allocated.
+         *
+         * A thread that has to wait on the ring - the owner for room under Block, the daemon for the
+         * owner's drop_oldest() - checks Wait_spins times, then sleeps on wait_condition after raising
+         * its flag; the other side notifies it under wait_mutex when it sees the flag.
+         */
+        struct Producer {
+            explicit Producer(std::size_t capacity)
+                : ring(capacity), orphaned(false), retired(false), hazard(nullptr), consuming(false), waiting_room(false), waiting_ring(false),
+                  dropped(0), spilled(0), report_to(std::thread::id()) {
+                ring.for_each_slot([](Record& record) { record.message.reserve(Record_reserve); });
+                overflow.message.reserve(Record_reserve);
+            }
+
+            Logger_ring<Record> ring;
+            std::atomic<bool> orphaned;
+            std::atomic<bool> retired;
+            std::atomic<const Routing_table*> hazard;   ///< Routing table this thread may be reading.
+            std::atomic<bool> consuming;                ///< Held by whoever pops from the ring - the daemon, or the owner dropping its oldest record.
+            std::atomic<bool> waiting_room;             ///< The owner sleeps until the daemon frees slots.
+            std::atomic<bool> waiting_ring;             ///< The daemon sleeps until the owner lets go of consuming.
+            std::mutex wait_mutex;
+            std::condition_variable wait_condition;
+            std::atomic<std::uint64_t> dropped;         ///< Records lost since the last overload report.
+            std::atomic<std::uint64_t> spilled;         ///< Records written to the spill file since the last overload report.
+            std::atomic<std::thread::id> report_to;     ///< Thread whose outputs get the overload report.
+            Record overflow;                            ///< Filled instead of a ring slot when the record is spilled.
+        };
+
+        /**
+         * @brief A remove_thread_ouput() call waiting for the daemon.
+         *
+         * marks holds how many records each ring had published when the call was made. The removal
+         * is applied once the daemon has consumed every ring up to its mark, so a message another
+         * thread logged for the removed thread before the call still reaches its outputs.
+         */
+        struct Removal {
+            std::thread::id thread_id;
+            std::uint64_t tick;
+            std::vector<std::pair<std::shared_ptr<Producer>, std::size_t>> marks;
+        };
+
+        /**
+         * @brief Thread-local list of the rings this thread owns, one per live logger.
+         */
+        struct Producer_cache {
+            ~Producer_cache();
+            std::vector<std::pair<unsigned long long, std::shared_ptr<Producer>>> entries;
+        };
+
         template <typename T> std::string convert_to_str(T data);
-        std::string get_time();
+        template <typename... Args>
+        bool log_format(std::thread::id thread_id, LogLevel level, bool has_level, const char* format, const Args&... args);
+        static void append_line(std::string& line, const char* time_text, std::size_t time_length, const std::string& thread_text,
+                                LogLevel level, bool has_level, const std::string& message);
+        static std::string canonical_path(const std::string& path);
+        std::shared_ptr<Output> open_output(Log_type _log, std::string path, bool append_);
+        Producer* local_producer();
+        Producer* register_producer();
+        const Routing_table* acquire_routes(std::atomic<const Routing_table*>& hazard);
+        std::uint32_t route_slot(Routing_table& table, std::thread::id thread_id);
+        void update_routes(std::thread::id thread_id, const std::shared_ptr<Output>* output, const std::string* name = nullptr);
+        void reclaim_routes();
+        std::uint32_t find_slot(std::thread::id thread_id);
+        std::uint32_t registered_slot(std::thread::id thread_id);
+        std::uint32_t daemon_slot(std::thread::id thread_id);
+        Record* claim_record(std::thread::id thread_id, std::uint32_t slot, Overload_policy policy);
+        bool drop_oldest(Producer& producer);
+        void wait_for_room(Producer& producer);
+        static void wait_for_output(Output& output);
+        void take_ring(Producer& producer);
+        void publish_record(Record& record);
+        void spill_record(Producer& producer, const Record& record);
+        bool enqueue(std::thread::id thread_id, std::uint32_t slot, std::uint64_t tick, LogLevel level, bool has_level, const char* message, std::size_t length, Overload_policy policy);
+        std::size_t drain_producers(bool report);
+        void apply_removals();
+        void handle_record(Record& record);
+        void stage_record(Record& record);
+        template <typename... Args>
+        void fill_report(Record& report, std::thread::id thread_id, LogLevel level, bool has_level, const char* format, const Args&... args);
+        static std::uint64_t repeat_hash(const char* format, const unsigned char* data, std::size_t size);
+        bool compact_record(Record& record);
+        void end_repeat(std::thread::id thread_id, Repeat& repeat);
+        void end_repeats();
+        static const unsigned char* record_args(const Record& record);
+        Batch_item& next_item();
+        void format_item(Batch_item& item);
+        Batch* new_batch();
+        void release_batch(Batch* batch);
+        Lane* lane_for(const std::shared_ptr<Output>& output);
+        void dispatch_batch();
+        void retire_lanes();
+        std::future<void> request_flush(std::thread::id thread_id, bool all_outputs);
+        void issue_barriers(std::vector<Flush_request>& requests);
+        bool overload_pending();
+        void report_overload();
+        static std::size_t latency_bucket(std::uint64_t nanoseconds);
+        std::chrono::steady_clock::time_point stats_deadline() const;
+        void report_stats();
         void daemon_thread();
+        static void crash_handler(void* context, int signal);
+        static void crash_park();
+        void crash_park_daemon();
+        void crash_add_lane(Lane* lane);
+        bool crash_remove_lane(Lane* lane);
+        void crash_flush(int signal);
+        void crash_record(Logger_crash::Writer& writer, const Record& record, std::int64_t wall_ns, const std::string* thread_text, const std::string* message);
+
+        static thread_local Producer_cache producer_cache_;
+        static std::atomic<unsigned long long> next_logger_id_;
+
+        const unsigned long long logger_id_;
+        const std::size_t ring_capacity_;
 
-        std::unordered_map<std::thread::id, std::vector<std::shared_ptr<Output>>> outputs_;     
-        std::mutex mutexlock_;      
-        std::mutex mutex_queue;                                                                
-        std::deque<std::pair<std::thread::id, std::string>> messages_queue;                     
-        std::condition_variable condition_; 
-        std::condition_variable condition_queue;                                                     
-        std::thread daemonthread_;                                                              
-        bool stop_daemon = false;                                                               
+        std::atomic<const Routing_table*> routes_;
+        std::mutex routes_mutex_;
+        std::vector<const Routing_table*> retired_routes_;
+        std::vector<std::uint32_t> free_slots_;     ///< Slots given up by removed threads. Needs routes_mutex_.
+        std::unordered_map<std::thread::id, std::shared_ptr<const std::string>> thread_names_;   ///< Names from set_thread_name(), kept across removals. Needs routes_mutex_.
+        std::atomic<const Routing_table*> daemon_hazard_;
+        const Routing_table* daemon_routes_;
+
+        std::unordered_map<std::string, std::weak_ptr<Output>> shared_outputs_;
+        std::mutex shared_outputs_mutex_;
+
+        std::mutex producers_mutex_;
+        std::vector<std::shared_ptr<Producer>> producers_;
+        std::atomic<std::size_t> producers_version_;
+        std::vector<std::shared_ptr<Producer>> drain_list_;
+        std::size_t drain_version_;
+
+        std::atomic<Flush_policy> flush_policy_;
+        std::atomic<std::size_t> flush_value_;
+        std::atomic<std::size_t> lane_capacity_;
+        Logger_time_formatter time_formatter_;
+
+        Batch* batch_;
+        std::mutex batch_pool_mutex_;
+        std::vector<Batch*> batch_pool_;
+        std::unordered_map<const Output*, std::unique_ptr<Lane>> lanes_;
+        std::vector<std::unique_ptr<Lane>> closing_lanes_;
+        std::vector<Lane*> touched_lanes_;
+        bool lanes_stale_;
+
+        std::atomic<LogLevel> log_level_;
+        std::atomic<Overload_policy> overload_policies_[Level_count];
+        std::mutex spill_mutex_;
+        std::unique_ptr<Logger_file> spill_file_;
+        std::string spill_path_;
+        Logger_time_formatter spill_formatter_;
+        std::string spill_text_;
+        std::string spill_line_;
+        std::chrono::steady_clock::time_point last_report_;
+
+        std::chrono::steady_clock::time_point created_;
+        std::atomic<std::uint64_t> handled_;        ///< Records taken from the rings. Counters written by the daemon only.
+        std::atomic<std::size_t> max_queue_depth_;
+        std::atomic<std::uint64_t> dropped_total_;  ///< Drops, spills and suppressed calls reported so far.
+        std::atomic<std::uint64_t> spilled_total_;
+        std::atomic<std::uint64_t> suppressed_total_;
+        std::atomic<std::uint64_t> folded_;
+        std::atomic<std::uint64_t> queue_latency_[Latency_buckets];
+        std::atomic<std::uint64_t> write_latency_[Latency_buckets];     ///< Added to by every lane.
+        std::atomic<std::thread::id> stats_to_;     ///< Thread whose outputs get the periodic stats report.
+        std::atomic<long long> stats_interval_;     ///< Milliseconds between stats reports, 0 for none.
+        std::chrono::steady_clock::time_point last_stats_;
+
+        std::atomic<bool> compaction_;
+        std::unordered_map<std::thread::id, Repeat> repeats_;
+        std::size_t repeats_pending_;               ///< Repeats with a count not written yet.
+
+        std::mutex removals_mutex_;
+        std::vector<Removal> removals_;
+        std::atomic<bool> removals_pending_;
+        std::vector<Removal> waiting_removals_;    ///< Taken over by the daemon, oldest first.
+
+        std::mutex flush_mutex_;
+        std::vector<Flush_request> flush_requests_;
+        std::atomic<bool> flush_pending_;
+
+        std::string crash_path_;
+        std::string crash_message_;                 ///< Reserved up front; crash_flush() renders into it without growing it.
+        Logger_time_formatter crash_formatter_;
+        int crash_signal_;
+        std::atomic<bool> crashing_;                ///< Set by crash_flush(); the daemon and the lanes stop before changing what it reads.
+        std::atomic<Producer*> crash_producers_[Crash_slots];  ///< Every ring, set when it is made - they live as long as the logger.
+        std::atomic<Batch*> crash_batches_[Crash_slots];       ///< Every batch, set when it is made - they live as long as the logger.
+        std::atomic<Lane*> crash_lanes_[Crash_slots];          ///< Live lanes, cleared by the daemon before one is freed.
+        std::atomic<const Routing_table*> crash_hazard_;       ///< Routing table crash_flush() reads thread names from.
+        Producer* draining_;                        ///< Ring the daemon is consuming, or nullptr. Daemon only.
+        std::size_t drained_;                       ///< Records of draining_ handled so far. Daemon only.
+        std::atomic<Producer*> parked_ring_;        ///< draining_ when the daemon stopped for crash_flush().
+        std::atomic<std::size_t> parked_drained_;   ///< drained_ then.
+
+        std::mutex wake_mutex_;
+        std::condition_variable condition_;
+        std::atomic<bool> daemon_sleeping_;
+        std::thread daemonthread_;
+        bool stop_daemon = false;
         
         API_command const Lg_START = "Logger_START";
         API_command const Lg_STOP = "Logger_STOP";
-        API_command const Thread_REMOVE = "Thread_RM";                                                               
+        API_command const Thread_REMOVE = "Thread_RM";
+        static const char Overload_format[];
+        static const char Limit_format[];
+        static const char Repeat_format[];
+        static const char Stats_format[];
+        static const char Output_stats_format[];                                                               
 };
 
+/**
+ * @brief               Log a message whose text is built on the daemon thread.
+ * @param thread_id     Id of the thread needs to be logged.
+ * @param format        Message with a "{}" placeholder per argument. Must be a string literal or
+ *                      otherwise outlive the logger - only the pointer is queued.
+ * @param arg, args     Values for the placeholders, copied into the queued record as binary.
+ */
+template <std::size_t N, typename Arg, typename... Args>
+bool Logger_async::add_log(std::thread::id thread_id, const char (&format)[N], const Arg& arg, const Args&... args) {
+    return log_format(thread_id, LogLevel::INFO, false, format, arg, args...);
+}
+
+/**
+ * @brief               Log a message of a given level whose text is built on the daemon thread.
+ * @param thread_id     Id of the thread needs to be logged.
+ * @param level         Severity; nothing is done if it is below the logger's level.
+ * @param format        Message with a "{}" placeholder per argument, or plain text. Must be a string
+ *                      literal or otherwise outlive the logger - only the pointer is queued.
+ * @param args          Values for the placeholders, copied into the queued record as binary.
+ */
+template <std::size_t N, typename... Args>
+bool Logger_async::add_log(std::thread::id thread_id, LogLevel level, const char (&format)[N], const Args&... args) {
+    if (!should_log(level)) return false;
+    return log_format(thread_id, level, true, format, args...);
+}
+
+/**
+ * @brief               Log a message of a given level if the rate limit of its call site lets it through.
+ * @param thread_id     Id of the thread needs to be logged.
+ * @param limit         Limit of the call site, usually a function-local static. A message it holds
+ *                      back is counted, and the count is logged about once a second.
+ * @param level         Severity; nothing is done if it is below the logger's level.
+ * @param format        As for add_log() with a level.
+ * @param args          Values for the placeholders; nothing is encoded for a message held back.
+ */
+template <std::size_t N, typename... Args>
+bool Logger_async::add_log(std::thread::id thread_id, Logger_limit& limit, LogLevel level, const char (&format)[N], const Args&... args) {
+    if (!should_log(level) || !limit.allow(this, thread_id)) return false;
+    return log_format(thread_id, level, true, format, args...);
+}
+
+/**
+ * @brief               Queue a record holding a format and its encoded arguments.
+ */
+template <typename... Args>
+bool Logger_async::log_format(std::thread::id thread_id, LogLevel level, bool has_level, const char* format, const Args&... args) {
+    std::uint64_t tick = Logger_clock::now();
+    std::uint32_t slot = registered_slot(thread_id);
+    if (slot == No_slot) return false;
+
+    std::size_t size = Logger_args::size_of(args...);
+    Record* record = claim_record(thread_id, slot, overload_policies_[static_cast<int>(level)].load(std::memory_order_relaxed));
+    if (!record) return false;
+    record->thread_id = thread_id;
+    record->slot = slot;
+    record->tick = tick;
+    record->format = format;
+    record->args_size = static_cast<std::uint32_t>(size);
+    record->level = level;
+    record->has_level = has_level;
+    if (size <= Inline_args) {
+        Logger_args::encode(record->args, args...);
+    }
+    else {
+        record->message.resize(size);
+        Logger_args::encode(reinterpret_cast<unsigned char*>(&record->message[0]), args...);
+    }
+    publish_record(*record);
+    return true;
+}
+
+/**
+ * @brief Lowest level the LOGGER_ASYNC_* macros compile in, 0 (TRACE) to 5 (FATAL).
+ *
+ * Calls below it expand to nothing, so their arguments are not even evaluated. It defaults to INFO
+ * when NDEBUG is defined and to TRACE otherwise. Calls that are compiled in check the runtime level
+ * before their arguments are evaluated.
+ */
+#ifndef LOGGER_ASYNC_MIN_LEVEL
+#ifdef NDEBUG
+#define LOGGER_ASYNC_MIN_LEVEL 2
+#else
+#define LOGGER_ASYNC_MIN_LEVEL 0
+#endif
+#endif
+
+#define LOGGER_ASYNC_LOG(logger, level, thread_id, ...) \
+    do { if ((logger).should_log(level)) (logger).add_log((thread_id), (level), __VA_ARGS__); } while (0)
+
+#if LOGGER_ASYNC_MIN_LEVEL <= 0
+#define LOGGER_ASYNC_TRACE(logger, thread_id, ...) LOGGER_ASYNC_LOG(logger, Logger_async::LogLevel::TRACE, thread_id, __VA_ARGS__)
+#else
+#define LOGGER_ASYNC_TRACE(logger, thread_id, ...) ((void)0)
+#endif
+
+#if LOGGER_ASYNC_MIN_LEVEL <= 1
+#define LOGGER_ASYNC_DEBUG(logger, thread_id, ...) LOGGER_ASYNC_LOG(logger, Logger_async::LogLevel::DEBUG, thread_id, __VA_ARGS__)
+#else
+#define LOGGER_ASYNC_DEBUG(logger, thread_id, ...) ((void)0)
+#endif
+
+#if LOGGER_ASYNC_MIN_LEVEL <= 2
+#define LOGGER_ASYNC_INFO(logger, thread_id, ...) LOGGER_ASYNC_LOG(logger, Logger_async::LogLevel::INFO, thread_id, __VA_ARGS__)
+#else
+#define LOGGER_ASYNC_INFO(logger, thread_id, ...) ((void)0)
+#endif
+
+#if LOGGER_ASYNC_MIN_LEVEL <= 3
+#define LOGGER_ASYNC_WARNING(logger, thread_id, ...) LOGGER_ASYNC_LOG(logger, Logger_async::LogLevel::WARNING, thread_id, __VA_ARGS__)
+#else
+#define LOGGER_ASYNC_WARNING(logger, thread_id, ...) ((void)0)
+#endif
+
+#if LOGGER_ASYNC_MIN_LEVEL <= 4
+#define LOGGER_ASYNC_ERROR(logger, thread_id, ...) LOGGER_ASYNC_LOG(logger, Logger_async::LogLevel::ERROR, thread_id, __VA_ARGS__)
+#else
+#define LOGGER_ASYNC_ERROR(logger, thread_id, ...) ((void)0)
+#endif
+
+#define LOGGER_ASYNC_FATAL(logger, thread_id, ...) LOGGER_ASYNC_LOG(logger, Logger_async::LogLevel::FATAL, thread_id, __VA_ARGS__)
+
+/**
+ * @brief Rate-limited logging, with a Logger_limit of its own for every place the macro is used.
+ *
+ * A call the limit holds back neither evaluates its arguments nor queues anything; the logger
+ * logs how many calls each site held back, as a WARNING to the outputs of the calling thread.
+ *
+ * @code
+ *   LOGGER_ASYNC_EVERY_N(logger, Logger_async::LogLevel::WARNING, thread_id, 1000, "Retry {}", attempt);
+ *   LOGGER_ASYNC_PER_SECOND(logger, Logger_async::LogLevel::ERROR, thread_id, 10, "Read failed: {}", error);
+ *   LOGGER_ASYNC_FIRST_N(logger, Logger_async::LogLevel::INFO, thread_id, 5, 100, "Slow request {}", id);
+ * @endcode
+ */
+#define LOGGER_ASYNC_SITE_LINE(line) #line
+#define LOGGER_ASYNC_SITE(line) __FILE__ ":" LOGGER_ASYNC_SITE_LINE(line)
+
+#define LOGGER_ASYNC_LIMITED(logger, level, thread_id, mode, count, sample, ...) \
+    do { \
+        static Logger_limit logger_async_limit_((mode), (count), (sample), LOGGER_ASYNC_SITE(__LINE__)); \
+        if ((logger).should_log(level) && logger_async_limit_.allow(&(logger), (thread_id))) \
+            (logger).add_log((thread_id), (level), __VA_ARGS__); \
+    } while (0)
+
+#define LOGGER_ASYNC_EVERY_N(logger, level, thread_id, n, ...) \
+    LOGGER_ASYNC_LIMITED(logger, level, thread_id, Logger_limit::Mode::Every_n, n, 0, __VA_ARGS__)
+#define LOGGER_ASYNC_PER_SECOND(logger, level, thread_id, k, ...) \
+    LOGGER_ASYNC_LIMITED(logger, level, thread_id, Logger_limit::Mode::Per_second, k, 0, __VA_ARGS__)
+#define LOGGER_ASYNC_FIRST_N(logger, level, thread_id, n, every, ...) \
+    LOGGER_ASYNC_LIMITED(logger, level, thread_id, Logger_limit::Mode::First_n, n, every, __VA_ARGS__)
+
 #endif // DATASTRUCTURES_HH
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef LOGGER_BINARY_HH
+#define LOGGER_BINARY_HH
+
+#include <cstdint>
+
+/**
+ * @brief Layout of the files written by Logger_async::Binary_Log and read by Logger_decode.
+ *
+ * A file starts with the 8-byte magic and is followed by a stream of blocks, each introduced by a
+ * one-byte tag. Integers are stored in the byte order of the writing machine.
+ *
+ *   Format_def  'F'  u32 id, u32 length, format text           - written once per format string
+ *   Thread_def  'T'  u32 id, u32 length, thread text           - written once per thread
+ *   Record      'R'  u32 format id, i64 wall-clock ns, u32 thread id, u8 level, u32 args size, Logger_args bytes
+ *
+ * The level byte holds the index of the message's level in Level_names, plus Level_tagged if the
+ * message was logged with an explicit level. Files with the older "LGBIN001" magic have no level byte.
+ *
+ * A definition always precedes the first record that refers to it, so a file can be decoded in one
+ * pass and a truncated file is readable up to the last complete record.
+ */
+namespace Logger_binary {
+    static const char Magic[8] = {'L', 'G', 'B', 'I', 'N', '0', '0', '2'};
+    static const char Magic_v1[8] = {'L', 'G', 'B', 'I', 'N', '0', '0', '1'};
+
+    enum Tag : unsigned char {
+        Format_def = 'F',
+        Thread_def = 'T',
+        Record = 'R'
+    };
+
+    /// Format given to plain text messages, which are stored as a single text argument.
+    static const char* const Text_format = "{}";
+
+    /// Names of the levels, in the order of Logger_async::LogLevel.
+    static const char* const Level_names[] = {"TRACE", "DEBUG", "INFO", "WARNING", "ERROR", "FATAL"};
+    static const unsigned char Level_tagged = 0x80;
+}
+
+#endif // LOGGER_BINARY_HH
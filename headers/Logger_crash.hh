@@ -0,0 +1,84 @@
+#ifndef LOGGER_CRASH_HH
+#define LOGGER_CRASH_HH
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+
+/**
+ * @brief Process-wide hooks run when the process dies of SIGSEGV, SIGABRT, SIGBUS or SIGFPE, or
+ *        through std::terminate.
+ *
+ * install() sets the handlers once; add() registers a function to run from them. The functions run
+ * once, on the crashing thread, inside a signal handler - they may only use async-signal-safe calls
+ * such as write(), and must not allocate or lock. Afterwards the handler that was set before
+ * install() is put back and the signal raised again, so the process still dies (and dumps core) as
+ * it would have. A second thread crashing while the hooks run does not run them again.
+ *
+ * Writer and the static helpers do buffered writes to a descriptor with nothing else than
+ * open(), write() and close(); nap() waits with nanosleep().
+ */
+class Logger_crash {
+    public:
+        typedef void (*Handler)(void* context, int signal);    ///< signal is 0 for std::terminate.
+
+        static const std::size_t Max_handlers = 16;
+
+        /**
+        * @brief Buffered writer for a crash handler - a fixed buffer, written out when full and at flush().
+        */
+        class Writer {
+            public:
+                Writer() : fd_(-1), owned_(false), used_(0) {}
+                explicit Writer(int fd) : fd_(fd), owned_(false), used_(0) {}
+                ~Writer();
+
+                Writer(const Writer&) = delete;
+                Writer& operator=(const Writer&) = delete;
+
+                bool open(const char* path);
+                bool is_open() const { return fd_ >= 0; }
+                void append(const char* data, std::size_t length);
+                void append(const char* text);
+                void append(const std::string& text) { append(text.data(), text.size()); }
+                void append_uint(std::uint64_t value);
+                void flush();
+
+            private:
+                int fd_;
+                bool owned_;                ///< The writer opened fd_ and closes it.
+                std::size_t used_;
+                char buffer_[4096];
+        };
+
+        static bool install();
+        static bool add(Handler handler, void* context);
+        static void remove(Handler handler, void* context);
+        static void run(int signal);
+
+        static int open_append(const char* path, bool binary = true);
+        static void write_all(int fd, const char* data, std::size_t length);
+        static void close_file(int fd);
+        static void nap();
+
+    private:
+        struct Slot {
+            std::atomic<Handler> handler;
+            std::atomic<void*> context;
+        };
+
+        static void on_signal(int signal);
+        static void on_terminate();
+        static void restore(int signal);
+
+        static Slot slots_[Max_handlers];
+        static std::atomic<bool> ran_;
+        static std::mutex mutex_;
+        static bool installed_;
+        static std::terminate_handler previous_terminate_;
+};
+
+#endif // LOGGER_CRASH_HH
@@ -0,0 +1,189 @@
+#ifndef LOGGER_DECODE_HH
+#define LOGGER_DECODE_HH
+
+#include "Logger_args.hh"
+#include "Logger_binary.hh"
+#include "Logger_time.hh"
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @brief Turns a file written by Logger_async::Binary_Log back into text lines.
+ *
+ * The file is untrusted input: every length read from it is checked against the bytes left in the
+ * file before anything is allocated or read, and the arguments of a record are rendered with
+ * Logger_args bounded by the record's own size. A record whose arguments run past it is skipped
+ * and counted; a file that ends inside a block is decoded up to the last complete record.
+ *
+ * Example:
+ * @code
+ *   std::ifstream in("logs/log.bin", std::ios::in | std::ios::binary);
+ *   Logger_decode::Result result = Logger_decode::decode(in, std::cout, false);
+ *   if (!result.error.empty()) std::cerr << result.error << std::endl;
+ * @endcode
+ */
+class Logger_decode {
+    public:
+        /**
+        * @brief What decode() found besides the lines it wrote.
+        */
+        struct Result {
+            std::size_t records = 0;        ///< Records written out.
+            std::size_t rejected = 0;       ///< Records skipped because their arguments were malformed.
+            bool truncated = false;         ///< The file ended inside a block.
+            std::string error;              ///< Why decoding stopped early, or "" if it reached the end.
+        };
+
+        /**
+        * @brief        Decode a binary log file into lines.
+        * @param in     The file, opened in binary mode.
+        * @param out    Stream the lines are written to.
+        * @param csv    Write time,thread,level,message rows, as CSV_Log does, instead of File_Log lines.
+        */
+        static Result decode(std::istream& in, std::ostream& out, bool csv) {
+            Result result;
+            std::uint64_t remaining = size_left(in);
+            char magic[sizeof(Logger_binary::Magic)];
+            bool has_levels = true;
+            if (!read_block(in, remaining, magic, sizeof(magic)) || !read_magic(magic, has_levels)) {
+                result.error = "not a binary log file";
+                return result;
+            }
+
+            std::unordered_map<std::uint32_t, std::string> formats;
+            std::unordered_map<std::uint32_t, std::string> threads;
+            Logger_time_formatter time_formatter;
+            std::string args, message, line;
+
+            if (csv) out << "time,thread,level,message\n";
+
+            char tag;
+            while (read_block(in, remaining, &tag, 1)) {
+                std::uint32_t id, length;
+                if (tag == Logger_binary::Format_def || tag == Logger_binary::Thread_def) {
+                    if (!read_value(in, remaining, id) || !read_value(in, remaining, length) || !read_bytes(in, remaining, length, message)) {
+                        result.truncated = true;
+                        break;
+                    }
+                    if (tag == Logger_binary::Format_def) formats[id] = message;
+                    else                                  threads[id] = message;
+                    continue;
+                }
+                if (tag == Logger_binary::Magic[0]) {
+                    // Another file appended to this one - its IDs start over.
+                    if (!read_block(in, remaining, magic + 1, sizeof(magic) - 1) || !read_magic(magic, has_levels)) {
+                        result.error = "corrupt file header";
+                        break;
+                    }
+                    formats.clear();
+                    threads.clear();
+                    continue;
+                }
+                if (tag != Logger_binary::Record) {
+                    result.error = std::string("unknown block '") + tag + "'";
+                    break;
+                }
+
+                std::uint32_t format_id, thread_id, args_size;
+                std::int64_t wall_ns;
+                unsigned char level = 0;
+                if (!read_value(in, remaining, format_id) || !read_value(in, remaining, wall_ns) || !read_value(in, remaining, thread_id)
+                    || (has_levels && !read_value(in, remaining, level)) || !read_value(in, remaining, args_size)
+                    || !read_bytes(in, remaining, args_size, args)) {
+                    result.truncated = true;
+                    break;
+                }
+
+                const char* level_name = "";
+                if (level & Logger_binary::Level_tagged) {
+                    unsigned char index = level & ~Logger_binary::Level_tagged;
+                    level_name = index < 6 ? Logger_binary::Level_names[index] : "?";
+                }
+                message.clear();
+                if (!csv && *level_name) message.append("[").append(level_name).append("] ");
+                std::unordered_map<std::uint32_t, std::string>::const_iterator format = formats.find(format_id);
+                if (!Logger_args::render(format != formats.end() ? format->second.c_str() : "", reinterpret_cast<const unsigned char*>(args.data()), args.size(), message)) {
+                    result.rejected++;
+                    continue;
+                }
+
+                char time_text[Logger_time_formatter::Max_length];
+                std::string time(time_text, time_formatter.format_wall(wall_ns, time_text));
+
+                line.clear();
+                if (csv) {
+                    Logger_args::append_csv_field(time, line);
+                    line.push_back(',');
+                    Logger_args::append_csv_field(threads[thread_id], line);
+                    line.push_back(',');
+                    line.append(level_name);
+                    line.push_back(',');
+                    Logger_args::append_csv_field(message, line);
+                }
+                else {
+                    line.append("[").append(time).append("] - [").append(threads[thread_id]).append("]\t- ").append(message);
+                }
+                line.push_back('\n');
+                out.write(line.data(), line.size());
+                result.records++;
+            }
+            return result;
+        }
+
+    private:
+        /**
+        * @brief        Bytes from the read position to the end of the stream; unlimited if it cannot seek.
+        */
+        static std::uint64_t size_left(std::istream& in) {
+            std::istream::pos_type start = in.tellg();
+            if (start == std::istream::pos_type(-1) || !in.seekg(0, std::ios::end)) return std::numeric_limits<std::uint64_t>::max();
+            std::istream::pos_type end = in.tellg();
+            in.seekg(start);
+            return end >= start ? static_cast<std::uint64_t>(end - start) : 0;
+        }
+
+        /**
+        * @brief        Read length bytes, if the file still holds that many.
+        */
+        static bool read_block(std::istream& in, std::uint64_t& remaining, char* data, std::size_t length) {
+            if (length > remaining || !in.read(data, length)) return false;
+            remaining -= length;
+            return true;
+        }
+
+        /**
+        * @brief        Read a fixed-size value from the stream.
+        */
+        template <typename T>
+        static bool read_value(std::istream& in, std::uint64_t& remaining, T& value) {
+            return read_block(in, remaining, reinterpret_cast<char*>(&value), sizeof(value));
+        }
+
+        /**
+        * @brief        Read a length-prefixed block of bytes; a length past the end of the file is
+        *               refused before anything is allocated.
+        */
+        static bool read_bytes(std::istream& in, std::uint64_t& remaining, std::uint32_t length, std::string& out) {
+            if (length > remaining) return false;
+            out.resize(length);
+            return length == 0 || read_block(in, remaining, &out[0], length);
+        }
+
+        /**
+        * @brief        Check a file header, telling whether its records carry a level byte.
+        */
+        static bool read_magic(const char* magic, bool& has_levels) {
+            if (std::memcmp(magic, Logger_binary::Magic, sizeof(Logger_binary::Magic)) == 0) has_levels = true;
+            else if (std::memcmp(magic, Logger_binary::Magic_v1, sizeof(Logger_binary::Magic_v1)) == 0) has_levels = false;
+            else return false;
+            return true;
+        }
+};
+
+#endif // LOGGER_DECODE_HH
@@ -0,0 +1,111 @@
+#ifndef LOGGER_FILE_HH
+#define LOGGER_FILE_HH
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
+/**
+ * @brief Buffered append-only file used by the file outputs, with a choice of write backend.
+ *
+ * append() only copies into memory; flush() hands everything to the operating system.
+ *  - Stream:   std::ofstream, one write and one flush per flush() (portable default).
+ *  - Vectored: raw descriptor, data kept in fixed-size chunks and written with one writev() per flush().
+ *  - Direct:   like Vectored, but the file is opened with O_DIRECT and written in 4 KiB-aligned blocks,
+ *              so log data bypasses the page cache instead of evicting the application's working set.
+ *              The last partial block is kept in memory, written padded and rewritten by the next
+ *              flush(); the file is cut back to its real length after every flush(). A flush() that
+ *              ends inside a block therefore costs one ftruncate() on top of the pwrite(), and the
+ *              next flush() writes up to 4 KiB of that block again.
+ * Where writev() or O_DIRECT are not available (Windows, or a file system refusing O_DIRECT), the
+ * raw backends fall back to plain write() of the same data.
+ *
+ * A write that fails for any reason but a signal drops the data it held; stats() counts the failures,
+ * the bytes lost and the last error.
+ */
+class Logger_file {
+    public:
+        enum class Backend {
+            Stream,
+            Vectored,
+            Direct
+        };
+
+        /**
+        * @brief Bytes and system calls since the file was opened.
+        */
+        struct Stats {
+            std::uint64_t bytes;
+            std::uint64_t syscalls;
+            std::uint64_t failures;         ///< Writes that failed, each dropping the data it held.
+            std::uint64_t lost;             ///< Bytes dropped by those failures.
+            int last_error;                 ///< errno of the last failure, or 0.
+            double seconds;
+
+            double bytes_per_second() const { return seconds > 0 ? bytes / seconds : 0; }
+            double syscalls_per_second() const { return seconds > 0 ? syscalls / seconds : 0; }
+        };
+
+        Logger_file(const std::string& path, bool append_, Backend backend = Backend::Stream, bool binary = false);
+        ~Logger_file();
+
+        Logger_file(const Logger_file&) = delete;
+        Logger_file& operator=(const Logger_file&) = delete;
+
+        bool is_open() const;
+        bool empty() const;
+        std::uint64_t size() const;
+        Backend backend() const { return backend_; }
+        void append(const char* data, std::size_t length);
+        void append(const std::string& data) { append(data.data(), data.size()); }
+        void flush();
+        void crash_flush();
+        Stats stats() const;
+
+    private:
+        static const std::size_t Chunk_size = 64 * 1024;
+        static const std::size_t Block_size = 4096;
+
+        bool open_raw(const std::string& path, bool append_, bool direct);
+        void write_chunks();
+        void write_blocks(bool final);
+        void close_raw();
+        void count_failure(std::uint64_t lost, int error);
+
+        Backend backend_;
+        std::string path_;
+        bool binary_;
+        std::ofstream stream_;
+        std::string buffer_;
+
+        int fd_;
+        std::vector<std::string> chunks_;
+        std::size_t used_chunks_;
+#ifndef _WIN32
+        std::vector<iovec> vectors_;            ///< One per chunk, grown with chunks_ so flush() allocates nothing.
+#endif
+
+        char* block_buffer_;
+        std::size_t block_capacity_;
+        std::size_t block_used_;
+        std::uint64_t block_offset_;
+
+        std::uint64_t file_size_;
+        std::uint64_t pending_;
+        std::atomic<std::uint64_t> bytes_;
+        std::atomic<std::uint64_t> syscalls_;
+        std::atomic<std::uint64_t> failures_;
+        std::atomic<std::uint64_t> lost_;
+        std::atomic<int> last_error_;
+        std::chrono::steady_clock::time_point opened_;
+};
+
+#endif // LOGGER_FILE_HH
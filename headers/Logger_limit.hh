@@ -0,0 +1,146 @@
+#ifndef LOGGER_LIMIT_HH
+#define LOGGER_LIMIT_HH
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "Logger_time.hh"
+
+/**
+ * @brief Rate limit of one logging call site - every Nth call, at most K calls a second, or the
+ *        first N calls and then every Mth.
+ *
+ * A limit is meant to be a function-local static at the call site (the LOGGER_ASYNC_EVERY_N,
+ * LOGGER_ASYNC_PER_SECOND and LOGGER_ASYNC_FIRST_N macros declare one). allow() is lock-free: an
+ * atomic increment, plus a clock reading and at most one compare-exchange per allowed call for a
+ * per-second limit. A call that is not allowed is only counted; the logger that owns the count
+ * takes it with take_suppressed() and logs a summary.
+ *
+ * Every limit ever constructed is linked into one process-wide list, which loggers walk to find
+ * their counts. A limit is never unlinked and has a trivial destructor, so the list stays valid
+ * while static objects are destroyed at exit. A call site shared by several loggers reports its
+ * count to whichever logger suppressed a call first since the last report.
+ */
+class Logger_limit {
+    public:
+        /**
+        * @brief Enum for how a limit picks the calls it lets through.
+        */
+        enum class Mode {
+            Every_n,        ///< Calls 0, N, 2N, ...
+            Per_second,     ///< At most K calls in any second, as a token bucket holding K tokens.
+            First_n         ///< Calls 0 to N-1, then every Mth call after them (none if M is 0).
+        };
+
+        /**
+        * @brief            Setting up a limit and linking it into the list of limits.
+        * @param mode       How calls are picked.
+        * @param count      N for Every_n and First_n, K for Per_second. 0 is taken as 1.
+        * @param sample     M for First_n; ignored otherwise.
+        * @param site       Static text naming the call site, e.g. "server.cpp:120".
+        */
+        Logger_limit(Mode mode, std::uint64_t count, std::uint64_t sample = 0, const char* site = "")
+            : mode_(mode), count_(count == 0 ? 1 : count), sample_(sample), site_(site),
+              interval_(1000000000ULL / (count == 0 ? 1 : count)), calls_(0), due_(0), suppressed_(0),
+              owner_(nullptr), report_to_(std::thread::id()), next_(nullptr) {
+            std::atomic<Logger_limit*>& head = list();
+            Logger_limit* first = head.load(std::memory_order_relaxed);
+            do {
+                next_ = first;
+            } while (!head.compare_exchange_weak(first, this, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        Logger_limit(const Logger_limit&) = delete;
+        Logger_limit& operator=(const Logger_limit&) = delete;
+
+        /**
+        * @brief            Any thread - decide whether a call may log, counting it if it may not.
+        * @param owner      Logger the suppressed count is reported to.
+        * @param thread_id  Thread whose outputs get the report.
+        */
+        bool allow(const void* owner, std::thread::id thread_id) {
+            if (pick()) return true;
+            if (suppressed_.fetch_add(1, std::memory_order_relaxed) == 0) {
+                owner_.store(owner, std::memory_order_relaxed);
+                report_to_.store(thread_id, std::memory_order_relaxed);
+            }
+            return false;
+        }
+
+        /**
+        * @brief            Check whether owner has suppressed calls that are not reported yet.
+        */
+        bool pending(const void* owner) const {
+            return suppressed_.load(std::memory_order_relaxed) != 0 && owner_.load(std::memory_order_relaxed) == owner;
+        }
+
+        /**
+        * @brief            Take the count of calls suppressed since the last report, if owner owns it.
+        * @param report_to  Set to the thread whose outputs get the report.
+        * @return           The count, or 0.
+        */
+        std::uint64_t take_suppressed(const void* owner, std::thread::id& report_to) {
+            if (!pending(owner)) return 0;
+            report_to = report_to_.load(std::memory_order_relaxed);
+            return suppressed_.exchange(0, std::memory_order_relaxed);
+        }
+
+        const char* site() const { return site_; }
+        Logger_limit* next() const { return next_; }
+
+        /**
+        * @brief            First limit of the process-wide list, or nullptr.
+        */
+        static Logger_limit* first() {
+            return list().load(std::memory_order_acquire);
+        }
+
+    private:
+        static std::atomic<Logger_limit*>& list() {
+            static std::atomic<Logger_limit*> head(nullptr);
+            return head;
+        }
+
+        /**
+        * @brief            Whether the mode lets this call through.
+        *
+        * Per_second keeps the time the next token is due (the generic cell rate algorithm): a call
+        * is let through if that time, pushed one interval on, is no more than a second ahead of now.
+        */
+        bool pick() {
+            switch (mode_) {
+            case Mode::Every_n:
+                return calls_.fetch_add(1, std::memory_order_relaxed) % count_ == 0;
+            case Mode::First_n: {
+                std::uint64_t call = calls_.fetch_add(1, std::memory_order_relaxed);
+                return call < count_ || (sample_ != 0 && (call - count_) % sample_ == 0);
+            }
+            case Mode::Per_second: {
+                std::uint64_t now = Logger_clock::now();
+                std::uint64_t due = due_.load(std::memory_order_relaxed);
+                for (;;) {
+                    std::uint64_t next = (due > now ? due : now) + interval_;
+                    if (next - now > 1000000000ULL) return false;
+                    if (due_.compare_exchange_weak(due, next, std::memory_order_relaxed)) return true;
+                }
+            }
+            }
+            return false;
+        }
+
+        const Mode mode_;
+        const std::uint64_t count_;
+        const std::uint64_t sample_;
+        const char* const site_;
+        const std::uint64_t interval_;              ///< Nanoseconds between Per_second tokens.
+
+        std::atomic<std::uint64_t> calls_;
+        std::atomic<std::uint64_t> due_;            ///< Logger_clock tick the next Per_second token is due.
+        std::atomic<std::uint64_t> suppressed_;
+        std::atomic<const void*> owner_;
+        std::atomic<std::thread::id> report_to_;
+        Logger_limit* next_;
+};
+
+#endif // LOGGER_LIMIT_HH
@@ -0,0 +1,196 @@
+#ifndef LOGGER_RING_HH
+#define LOGGER_RING_HH
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Bounded single-producer / single-consumer ring buffer.
+ *
+ * Exactly one thread may push and exactly one thread may pop at any time; neither side takes a lock.
+ * The capacity is rounded up to a power of two so positions wrap with a mask. Each side keeps a
+ * private copy of the other side's position and only reloads the shared atomic when the copy says
+ * the ring is full (producer) or empty (consumer), so the two cache lines are rarely shared.
+ */
+template <typename T>
+class Logger_ring {
+    public:
+        /**
+        * @brief            Create a ring holding at least capacity items.
+        * @param capacity   Requested number of slots, rounded up to a power of two.
+        */
+        explicit Logger_ring(std::size_t capacity)
+            : head_(0), cached_tail_(0), tail_(0), cached_head_(0) {
+            std::size_t size = 2;
+            while (size < capacity) size <<= 1;
+            slots_.resize(size);
+            mask_ = size - 1;
+        }
+
+        Logger_ring(const Logger_ring&) = delete;
+        Logger_ring& operator=(const Logger_ring&) = delete;
+
+        /**
+        * @brief            Producer side - move an item into the ring.
+        * @param item       The item to push, left moved-from on success.
+        * @return           False if the ring is full.
+        */
+        bool try_push(T&& item) {
+            std::size_t head = head_.load(std::memory_order_relaxed);
+            if (head - cached_tail_ > mask_) {
+                cached_tail_ = tail_.load(std::memory_order_acquire);
+                if (head - cached_tail_ > mask_) return false;
+            }
+            slots_[head & mask_] = std::move(item);
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+        * @brief            Producer side - reserve the next slot so an item can be built in place.
+        * @return           The slot to fill, or nullptr if the ring is full. Make it visible with publish().
+        */
+        T* try_claim() {
+            std::size_t head = head_.load(std::memory_order_relaxed);
+            if (head - cached_tail_ > mask_) {
+                cached_tail_ = tail_.load(std::memory_order_acquire);
+                if (head - cached_tail_ > mask_) return nullptr;
+            }
+            return &slots_[head & mask_];
+        }
+
+        /**
+        * @brief            Producer side - hand the slot returned by try_claim() to the consumer.
+        */
+        void publish() {
+            head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        /**
+        * @brief            Consumer side - move the oldest item out of the ring.
+        * @param item       Receives the popped item.
+        * @return           False if the ring is empty.
+        */
+        bool try_pop(T& item) {
+            std::size_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail == cached_head_) {
+                cached_head_ = head_.load(std::memory_order_acquire);
+                if (tail == cached_head_) return false;
+            }
+            item = std::move(slots_[tail & mask_]);
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+        * @brief            Consumer side - the oldest item, left in the ring.
+        * @return           The item, or nullptr if the ring is empty.
+        */
+        T* front() {
+            std::size_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail == cached_head_) {
+                cached_head_ = head_.load(std::memory_order_acquire);
+                if (tail == cached_head_) return nullptr;
+            }
+            return &slots_[tail & mask_];
+        }
+
+        /**
+        * @brief            Consumer side - release the item returned by front() without moving it out.
+        */
+        void pop_front() {
+            tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        /**
+        * @brief            Consumer side - hand every item queued so far to handler, then release them at once.
+        * @param handler    Called with a reference to each item, oldest first; it may move from the item.
+        * @return           Number of items consumed.
+        *
+        * The producer position is read once and the consumer position is published once, so a whole
+        * backlog is taken over in O(1) synchronisation regardless of its length.
+        */
+        template <typename Handler>
+        std::size_t consume_all(Handler&& handler) {
+            std::size_t tail = tail_.load(std::memory_order_relaxed);
+            std::size_t head = head_.load(std::memory_order_acquire);
+            cached_head_ = head;
+            for (std::size_t pos = tail; pos != head; ++pos)
+                handler(slots_[pos & mask_]);
+            if (head != tail) tail_.store(head, std::memory_order_release);
+            return head - tail;
+        }
+
+        /**
+        * @brief            Either side - check whether the ring currently holds no items.
+        */
+        bool empty() const {
+            return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+        }
+
+        /**
+        * @brief            Either side - number of items queued; it may be stale by the time it returns.
+        */
+        std::size_t size() const {
+            std::size_t tail = tail_.load(std::memory_order_acquire);
+            return head_.load(std::memory_order_acquire) - tail;
+        }
+
+        /**
+        * @brief            Either side - number of items published since the ring was made.
+        */
+        std::size_t pushed() const {
+            return head_.load(std::memory_order_acquire);
+        }
+
+        /**
+        * @brief            Either side - number of items released by the consumer since the ring was made.
+        */
+        std::size_t consumed() const {
+            return tail_.load(std::memory_order_acquire);
+        }
+
+        std::size_t capacity() const {
+            return mask_ + 1;
+        }
+
+        /**
+        * @brief            Set up every slot, e.g. to reserve buffers, before either side uses the ring.
+        * @param function   Called with a reference to each slot.
+        */
+        template <typename Function>
+        void for_each_slot(Function&& function) {
+            for (T& slot : slots_)
+                function(slot);
+        }
+
+        /**
+        * @brief            Any thread - call function with each queued item, oldest first, leaving them queued.
+        * @param function   Called with a const reference to each item.
+        *
+        * Meant for a crash dump only: nothing stops the consumer from taking the items meanwhile.
+        */
+        template <typename Function>
+        void for_each_queued(Function&& function) const {
+            std::size_t tail = tail_.load(std::memory_order_acquire);
+            std::size_t head = head_.load(std::memory_order_acquire);
+            for (std::size_t pos = tail; pos != head; ++pos)
+                function(static_cast<const T&>(slots_[pos & mask_]));
+        }
+
+    private:
+        std::vector<T> slots_;
+        std::size_t mask_;
+        char pad0_[64];
+
+        std::atomic<std::size_t> head_;
+        std::size_t cached_tail_;
+        char pad1_[64];
+
+        std::atomic<std::size_t> tail_;
+        std::size_t cached_head_;
+        char pad2_[64];
+};
+
+#endif // LOGGER_RING_HH
@@ -0,0 +1,108 @@
+#ifndef LOGGER_ROTATE_HH
+#define LOGGER_ROTATE_HH
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Logger_file.hh"
+
+/**
+ * @brief Rotation of a log file by size and by time, with the old segments compressed and pruned
+ *        on a low-priority background thread.
+ *
+ * The writer asks due() before each write. When it is due the writer hands its open file to rotate(),
+ * which renames it to "<path>.<yyyymmdd-hhmmss>" and takes it over, and then opens the path again.
+ * Rotating costs the writer one rename() and one open(): the segment must be moved out of the path
+ * before the next line goes to it, or segments would overrun max_bytes and lines could land in the
+ * wrong one. Everything slower happens on the rotation's own thread, started at the first rotation:
+ * flushing and closing the segment, Policy::compressor, and deleting segments beyond Policy::keep.
+ * Windows cannot rename an open file, so there the writer closes it first and the flush stays on it.
+ *
+ * Only segments rotated by this instance count towards keep; segments of earlier runs are left alone.
+ * There is no built-in compression, so the logger needs no library beyond the standard one; set
+ * Policy::compressor to compress segments, e.g. with zlib. Policy::compress without a compressor is
+ * turned off and take_warning() says so.
+ *
+ * If the file cannot be renamed the writer keeps appending to it, and the size trigger stays off for
+ * Retry_seconds instead of firing again at every write.
+ */
+class Logger_rotation {
+    public:
+        static const int Retry_seconds = 60;
+
+        enum class Interval {
+            None,
+            Hourly,         ///< At the first write after a local hour starts.
+            Daily           ///< At the first write after local midnight.
+        };
+
+        /**
+        * @brief When to rotate, and what happens to the rotated segments.
+        */
+        struct Policy {
+            std::uint64_t max_bytes;        ///< Rotate before a write would make the file larger; 0 for no limit.
+            Interval interval;
+            std::size_t keep;               ///< Rotated segments kept, newest first; 0 keeps all.
+            bool compress;                  ///< Compress every rotated segment to "<segment>.gz" with compressor.
+            std::function<bool(const std::string& from, const std::string& to)> compressor;    ///< Writes "to" from "from"; false if it failed.
+
+            Policy() : max_bytes(0), interval(Interval::None), keep(0), compress(false) {}
+        };
+
+        Logger_rotation(const std::string& path, const Policy& policy);
+        ~Logger_rotation();
+
+        Logger_rotation(const Logger_rotation&) = delete;
+        Logger_rotation& operator=(const Logger_rotation&) = delete;
+
+        bool enabled() const { return policy_.max_bytes != 0 || policy_.interval != Interval::None; }
+        bool due(std::uint64_t size, std::size_t length);
+        std::string rotate(std::unique_ptr<Logger_file>& file);
+        void wait_idle();
+        std::vector<std::string> segments();
+        std::string take_warning();
+
+    private:
+        /**
+        * @brief A renamed segment, with its file if the writer left it open.
+        */
+        struct Job {
+            std::string segment;
+            std::unique_ptr<Logger_file> file;      ///< Flushed and closed by the worker before anything else.
+        };
+
+        void schedule(std::time_t now);
+        std::string segment_name(std::time_t now);
+        void worker();
+        static void lower_priority();
+
+        const std::string path_;
+        const Policy policy_;
+        bool compress_;
+        std::chrono::system_clock::time_point next_rotation_;
+        bool failing_;                          ///< The last rename failed; due() waits for retry_after_.
+        std::chrono::steady_clock::time_point retry_after_;
+        std::string warning_;                   ///< Not yet taken by the writer.
+        std::string last_stamp_;
+        unsigned sequence_;
+
+        std::mutex mutex_;
+        std::condition_variable condition_;
+        std::condition_variable idle_condition_;
+        std::deque<Job> jobs_;                  ///< Renamed segments waiting for the worker.
+        std::deque<std::string> segments_;      ///< Finished segments, oldest first.
+        bool busy_;
+        bool stop_;
+        std::thread thread_;
+};
+
+#endif // LOGGER_ROTATE_HH
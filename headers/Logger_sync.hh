@@ -3,8 +3,13 @@
 #include <sstream>
 #include <string>
 #include <vector>
+#include <memory>
 #include <mutex>
+#include <atomic>
 #include <ctime>
+#include <algorithm>
+
+#include "Logger_time.hh"
 
 class Logger_sync {
     public:
@@ -50,74 +55,132 @@ class Logger_sync {
         };
 
         // Constructor
-        Logger_sync() : log_level_(LogLevel::DEBUG) {
-            outputs_.push_back(std::make_unique<ConsoleOutput>());
+        Logger_sync() : log_level_(LogLevel::DEBUG), sink_count_(0) {
+            tables_.push_back(std::unique_ptr<Sink_table>(new Sink_table(Initial_capacity)));
+            table_.store(tables_.back().get(), std::memory_order_relaxed);
+            add_output(std::unique_ptr<Output>(new ConsoleOutput()));
         }
 
-        // Add an output source
+        // Add an output source; logging threads see it without taking a lock
         void add_output(std::unique_ptr<Output> output) {
             std::lock_guard<std::mutex> lock(mutex_);
-            outputs_.push_back(std::move(output));
+            std::size_t count = sink_count_.load(std::memory_order_relaxed);
+            Sink_table* table = table_.load(std::memory_order_relaxed);
+            if (count == table->sinks.size()) {
+                // Publish a copy twice as large; the old table stays for threads still reading it
+                tables_.push_back(std::unique_ptr<Sink_table>(new Sink_table(2 * count)));
+                std::copy(table->sinks.begin(), table->sinks.end(), tables_.back()->sinks.begin());
+                table = tables_.back().get();
+                table_.store(table, std::memory_order_release);
+            }
+            sinks_.push_back(std::unique_ptr<Sink>(new Sink()));
+            sinks_.back()->output = std::move(output);
+            table->sinks[count] = sinks_.back().get();
+            sink_count_.store(count + 1, std::memory_order_release);
         }
 
         // Set the log level
         void set_log_level(LogLevel log_level) {
-            log_level_ = log_level;
+            log_level_.store(log_level, std::memory_order_relaxed);
         }
 
-        //Get the current time
-        std::string get_time() {
-            time_t current_time = time(0);
-            // Convert the time to a string
-            char time_str[26];
-            errno_t error = ctime_s(time_str, sizeof(time_str), &current_time);
-
-            return time_str;
-        }
-
-        // Log a message
+        // Log a message - the line is built in a per-thread buffer, only the writes to each output are locked.
+        // A log made while that buffer is in use (from an operator<< or an Output) builds its line in a fresh one
         template <typename T>
-        void log(LogLevel level, T message) {
+        void log(LogLevel level, const T& message) {
             // Check if the log level is high enough
-            if (level < log_level_) {
+            if (level < log_level_.load(std::memory_order_relaxed)) {
                 return;
             }
 
-            std::lock_guard<std::mutex> lock(mutex_);
+            static const char* const level_names[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
+            static thread_local Logger_time_formatter formatter;
+            Nesting nesting;
+            std::string fresh_message;
+            std::string& formatted_message = nesting.outermost() ? line_buffer() : fresh_message;
 
             // Format the message
-            std::string level_str;
-            switch (level) {
-            case LogLevel::DEBUG:
-                level_str = "DEBUG";
-                break;
-            case LogLevel::INFO:
-                level_str = "INFO";
-                break;
-            case LogLevel::WARNING:
-                level_str = "WARNING";
-                break;
-            case LogLevel::ERROR:
-                level_str = "ERROR";
-                break;
+            char time_text[Logger_time_formatter::Max_length];
+            std::size_t time_length = formatter.format(Logger_clock::now(), time_text);
+            formatted_message.assign("[").append(time_text, time_length).append("] - [")
+                             .append(level_names[static_cast<int>(level)]).append("]:\t");
+            append_message(formatted_message, message, nesting.outermost());
+
+            // write the message to all outputs, each under its own lock
+            std::size_t count = sink_count_.load(std::memory_order_acquire);
+            const Sink_table* table = table_.load(std::memory_order_acquire);
+            for (std::size_t i = 0; i < count; i++) {
+                Sink* sink = table->sinks[i];
+                std::lock_guard<std::mutex> lock(sink->mutex);
+                sink->output->write(formatted_message);
             }
+        }
 
-            std::string time_str = get_time();
-            time_str.erase(time_str.end() - 1);
+    private:
+        static const std::size_t Initial_capacity = 16;
 
-            std::stringstream stream;
-            stream << message;
+        // An output and the lock that serialises writes to it
+        struct Sink {
+            std::unique_ptr<Output> output;
+            std::mutex mutex;
+        };
+
+        // Published sinks; entries below sink_count_ never change, the table is replaced when full
+        struct Sink_table {
+            explicit Sink_table(std::size_t capacity) : sinks(capacity, nullptr) {}
+            std::vector<Sink*> sinks;
+        };
+
+        // Depth of log() calls on the calling thread; only the outermost one may use the per-thread buffers
+        class Nesting {
+            public:
+                Nesting() : depth_(depth()) { ++depth_; }
+                ~Nesting() { --depth_; }
+                bool outermost() const { return depth_ == 1; }
 
-            std::string formatted_message = "[" + time_str + "] - [" + level_str + "]:\t" + stream.str();
+            private:
+                static int& depth() {
+                    static thread_local int value = 0;
+                    return value;
+                }
+
+                int& depth_;
+        };
+
+        // Reused line of the calling thread, so formatting does not allocate once it has grown
+        static std::string& line_buffer() {
+            static thread_local std::string buffer;
+            return buffer;
+        }
+
+        static void append_message(std::string& out, const std::string& message, bool) {
+            out.append(message);
+        }
+
+        static void append_message(std::string& out, const char* message, bool) {
+            out.append(message);
+        }
 
-            // write the message to all outputs
-            for (auto& output : outputs_) {
-                output->write(formatted_message);
+        // Any other type goes through its operator<<, with one stream per thread for the outermost log()
+        template <typename T>
+        static void append_message(std::string& out, const T& message, bool outermost) {
+            if (!outermost) {
+                std::ostringstream stream;
+                stream << message;
+                out.append(stream.str());
+                return;
             }
+            static thread_local std::ostringstream stream;
+            stream.str(std::string());
+            stream.clear();
+            stream << message;
+            out.append(stream.str());
         }
 
-    private:
-        std::vector<std::unique_ptr<Output>> outputs_;
-        LogLevel log_level_;
+        std::atomic<LogLevel> log_level_;
+        std::vector<std::unique_ptr<Sink>> sinks_;
+        std::vector<std::unique_ptr<Sink_table>> tables_;     // Every table published, freed with the logger
+        std::atomic<Sink_table*> table_;
+        std::atomic<std::size_t> sink_count_;
         std::mutex mutex_;
 };
@@ -21,6 +21,26 @@ class Logger_test
         void test_logger_multithread(Logger_async &logger);
         void test_huge_logs_load(Logger_async &logger, int num_line=10000);
         void test_logger_create_file(Logger_async &logger);
+        void test_deferred_format(Logger_async &logger);
+        void test_file_backends(Logger_async &logger, int num_line=1000);
+        void test_overload_policy(int num_line=1000);
+        void test_slow_output(Logger_async &logger, int num_line=200);
+        void test_lane_capacity(Logger_async &logger, int num_line=200);
+        void test_stalled_output(Logger_async &logger, int num_line=200);
+        void test_log_level(Logger_async &logger);
+        void test_flush(Logger_async &logger, int num_line=1000);
+        void test_file_rotation(Logger_async &logger, int num_line=1000);
+        void test_csv_output(Logger_async &logger);
+        void test_json_output(Logger_async &logger);
+        void test_allocations(Logger_async &logger, int num_line=1000);
+        void test_console_output(Logger_async &logger);
+        void test_crash_flush(int num_line=1000);
+        void test_rate_limit(Logger_async &logger, int num_line=10000);
+        void test_compaction(Logger_async &logger, int num_line=1000);
+        void test_stats(Logger_async &logger, int num_line=1000);
+        void test_thread_name(Logger_async &logger);
+        void test_remove_order(Logger_async &logger, int num_line=1000);
+        void test_decode_corrupt(Logger_async &logger, int num_line=20);
         void test_report();
 
         template <typename T>  std::string convert_to_str(T data) {
@@ -30,6 +50,7 @@ class Logger_test
         }
     
     private:
+        std::string drop_microseconds(const std::string& line);
         void count_failed_test();
         void count_total_test();
 
@@ -37,7 +58,30 @@ class Logger_test
                                                     "logs/test2/test_file_output.txt",
                                                     "logs/test3/log_multithread.txt",
                                                     "logs/test4/log_hugeload.txt",
-                                                    "logs/test5/test_logger_create_file.csv"
+                                                    "logs/test5/test_logger_create_file.csv",
+                                                    "logs/test6/test_deferred_format.txt",
+                                                    "logs/test7/test_file_vectored.txt",
+                                                    "logs/test8/test_file_direct.txt",
+                                                    "logs/test9/test_overload_policy.txt",
+                                                    "logs/test10/test_log_level.txt",
+                                                    "logs/test11/test_flush.txt",
+                                                    "logs/test12/test_rotation.txt",
+                                                    "logs/test13/test_csv_output.csv",
+                                                    "logs/test14/test_json_output.jsonl",
+                                                    "logs/test15/test_allocations.txt",
+                                                    "logs/test15/test_allocations.csv",
+                                                    "logs/test16/test_console_stdout.txt",
+                                                    "logs/test16/test_console_stderr.txt",
+                                                    "logs/test17/test_crash_flush.txt",
+                                                    "logs/test17/test_crash_flush_queue.txt",
+                                                    "logs/test18/test_rate_limit.txt",
+                                                    "logs/test19/test_compaction.txt",
+                                                    "logs/test20/test_stats.txt",
+                                                    "logs/test21/test_thread_name.txt",
+                                                    "logs/test22/test_remove_order.txt",
+                                                    "logs/test22/test_remove_order_flood.txt",
+                                                    "logs/test23/test_decode_corrupt.bin",
+                                                    "logs/test24/test_stalled_output.txt"
                                                 };
         int failed_tests = 0;
         int total_tests = 0;
@@ -0,0 +1,193 @@
+#ifndef LOGGER_TIME_HH
+#define LOGGER_TIME_HH
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+/**
+ * @brief Cheap monotonic clock used to stamp log records where they are created.
+ *
+ * A tick is a steady_clock reading in nanoseconds. It costs one vDSO/QPC call and never jumps,
+ * so it is safe to take on the producer side; Logger_time_formatter turns it into wall-clock text.
+ */
+struct Logger_clock {
+    static std::uint64_t now() {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+};
+
+/**
+ * @brief Converts Logger_clock ticks to "Wed Jan 04 17:27:47.123456 2023".
+ *
+ * The text of the current second is built with strftime once and cached; formatting a timestamp
+ * inside that second only copies the prefix and writes the six microsecond digits. The mapping
+ * from ticks to wall-clock time is re-anchored once a second of ticks has passed, so clock
+ * adjustments are followed.
+ * An instance is not thread-safe - use one per formatting thread.
+ */
+class Logger_time_formatter {
+    public:
+        static const std::size_t Max_length = 32;
+
+        Logger_time_formatter() : cached_second_(0) {
+            anchor();
+        }
+
+        /**
+        * @brief        Write the wall-clock text of tick into out, without a terminating zero.
+        * @param tick   A Logger_clock::now() reading.
+        * @param out    Buffer of at least Max_length characters.
+        * @return       Number of characters written.
+        */
+        std::size_t format(std::uint64_t tick, char* out) {
+            return format_wall(to_wall_ns(tick), out);
+        }
+
+        /**
+        * @brief        Convert a Logger_clock tick to nanoseconds since the Unix epoch.
+        * @param tick   A Logger_clock::now() reading.
+        */
+        std::int64_t to_wall_ns(std::uint64_t tick) {
+            if (tick > tick_anchor_ && tick - tick_anchor_ > 1000000000ULL) anchor();
+            return wall_anchor_ns_ + static_cast<std::int64_t>(tick - tick_anchor_);
+        }
+
+        /**
+        * @brief        Write the text of a wall-clock time into out, without a terminating zero.
+        * @param wall_ns Nanoseconds since the Unix epoch.
+        * @param out    Buffer of at least Max_length characters.
+        * @return       Number of characters written.
+        */
+        std::size_t format_wall(std::int64_t wall_ns, char* out) {
+            std::int64_t second = wall_ns / 1000000000;
+            std::int64_t nanos = wall_ns % 1000000000;
+            if (nanos < 0) {
+                nanos += 1000000000;
+                second--;
+            }
+            if (second != cached_second_ || prefix_length_ == 0) cache_second(second);
+
+            std::memcpy(out, prefix_, prefix_length_);
+            char* cursor = out + prefix_length_;
+            *cursor++ = '.';
+            std::int64_t micros = nanos / 1000;
+            for (int i = 5; i >= 0; i--) {
+                cursor[i] = static_cast<char>('0' + micros % 10);
+                micros /= 10;
+            }
+            cursor += 6;
+            std::memcpy(cursor, suffix_, suffix_length_);
+            return prefix_length_ + 7 + suffix_length_;
+        }
+
+        /**
+        * @brief        Write a wall-clock time as "2023-01-04 17:27:47.123456 UTC" into out, without a
+        *               terminating zero. Only arithmetic is used - no localtime() - so a signal handler may call it.
+        * @param wall_ns Nanoseconds since the Unix epoch.
+        * @param out    Buffer of at least Max_length characters.
+        * @return       Number of characters written.
+        */
+        static std::size_t format_utc(std::int64_t wall_ns, char* out) {
+            std::int64_t second = wall_ns / 1000000000;
+            std::int64_t nanos = wall_ns % 1000000000;
+            if (nanos < 0) {
+                nanos += 1000000000;
+                second--;
+            }
+            std::int64_t days = second / 86400;
+            std::int64_t time_of_day = second % 86400;
+            if (time_of_day < 0) {
+                time_of_day += 86400;
+                days--;
+            }
+
+            // Civil date of a day count (proleptic Gregorian calendar), in 400-year eras.
+            days += 719468;
+            std::int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+            std::int64_t day_of_era = days - era * 146097;
+            std::int64_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+            std::int64_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+            std::int64_t month_index = (5 * day_of_year + 2) / 153;
+            std::int64_t day = day_of_year - (153 * month_index + 2) / 5 + 1;
+            std::int64_t month = month_index < 10 ? month_index + 3 : month_index - 9;
+            std::int64_t year = year_of_era + era * 400 + (month <= 2 ? 1 : 0);
+
+            char* cursor = out;
+            cursor = put_digits(cursor, year, 4);
+            *cursor++ = '-';
+            cursor = put_digits(cursor, month, 2);
+            *cursor++ = '-';
+            cursor = put_digits(cursor, day, 2);
+            *cursor++ = ' ';
+            cursor = put_digits(cursor, time_of_day / 3600, 2);
+            *cursor++ = ':';
+            cursor = put_digits(cursor, time_of_day / 60 % 60, 2);
+            *cursor++ = ':';
+            cursor = put_digits(cursor, time_of_day % 60, 2);
+            *cursor++ = '.';
+            cursor = put_digits(cursor, nanos / 1000, 6);
+            std::memcpy(cursor, " UTC", 4);
+            return static_cast<std::size_t>(cursor + 4 - out);
+        }
+
+        /**
+        * @brief        Wall-clock text of tick as a string.
+        * @param tick   A Logger_clock::now() reading.
+        */
+        std::string format(std::uint64_t tick) {
+            char text[Max_length];
+            return std::string(text, format(tick, text));
+        }
+
+    private:
+        /**
+        * @brief        Write the last count decimal digits of value, zero-padded.
+        */
+        static char* put_digits(char* out, std::int64_t value, int count) {
+            if (value < 0) value = 0;
+            for (int i = count - 1; i >= 0; i--) {
+                out[i] = static_cast<char>('0' + value % 10);
+                value /= 10;
+            }
+            return out + count;
+        }
+
+        /**
+        * @brief        Pair the current tick with the current wall-clock time.
+        */
+        void anchor() {
+            tick_anchor_ = Logger_clock::now();
+            wall_anchor_ns_ = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+
+        /**
+        * @brief        Render the date and time of second with strftime and keep it.
+        */
+        void cache_second(std::int64_t second) {
+            std::time_t seconds = static_cast<std::time_t>(second);
+            std::tm local_time;
+#ifdef _WIN32
+            localtime_s(&local_time, &seconds);
+#else
+            localtime_r(&seconds, &local_time);
+#endif
+            prefix_length_ = std::strftime(prefix_, sizeof(prefix_), "%a %b %d %H:%M:%S", &local_time);
+            suffix_length_ = std::strftime(suffix_, sizeof(suffix_), " %Y", &local_time);
+            cached_second_ = second;
+        }
+
+        std::uint64_t tick_anchor_;
+        std::int64_t wall_anchor_ns_;
+        std::int64_t cached_second_;
+        char prefix_[20];
+        char suffix_[6];
+        std::size_t prefix_length_ = 0;
+        std::size_t suffix_length_ = 0;
+};
+
+#endif // LOGGER_TIME_HH
@@ -1,14 +1,53 @@
 ﻿#include "../headers/Logger_async.hh"
 
+#include <cstdlib>
+#include <climits>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+thread_local Logger_async::Producer_cache Logger_async::producer_cache_;
+std::atomic<unsigned long long> Logger_async::next_logger_id_(0);
+const char Logger_async::Overload_format[] = "Logger overload: {} messages dropped, {} spilled";
+const char Logger_async::Limit_format[] = "Logger rate limit: {} messages suppressed at {}";
+const char Logger_async::Repeat_format[] = "Last message repeated {} times between {} and {}";
+const char Logger_async::Stats_format[] = "Logger stats: {} enqueued, {} dropped, {} spilled, {} suppressed, queue {} (max {}), wait p50 {} us p99 {} us, write p99 {} us";
+const char Logger_async::Output_stats_format[] = "Logger stats: output {} wrote {} messages, {} bytes in {} us, {} dropped, backlog {} (max {})";
+
 /**
- * @brief Constructor of the logger, start the daemon thread.
+ * @brief               Constructor of the logger, start the daemon thread.
+ * @param ring_capacity Number of messages each producer thread can queue before it has to wait.
  */
-Logger_async::Logger_async() {
+Logger_async::Logger_async(std::size_t ring_capacity)
+    : logger_id_(++next_logger_id_), ring_capacity_(ring_capacity),
+      routes_(new Routing_table()), daemon_hazard_(nullptr), daemon_routes_(nullptr), producers_version_(0), drain_version_(static_cast<std::size_t>(-1)),
+      flush_policy_(Flush_policy::Per_batch), flush_value_(0), lane_capacity_(Default_lane_capacity), batch_(nullptr), lanes_stale_(false), log_level_(LogLevel::TRACE),
+      created_(std::chrono::steady_clock::now()), handled_(0), max_queue_depth_(0), dropped_total_(0), spilled_total_(0), suppressed_total_(0), folded_(0),
+      stats_to_(std::thread::id()), stats_interval_(0), compaction_(false), repeats_pending_(0), removals_pending_(false), flush_pending_(false), crash_signal_(0), crashing_(false),
+      crash_hazard_(nullptr), draining_(nullptr), drained_(0), parked_ring_(nullptr), parked_drained_(0), daemon_sleeping_(false) {
     assert(__cplusplus >= 201103L && "This API needs at least a C++11 compliant compiler");
+    for (auto& policy : overload_policies_)
+        policy.store(Overload_policy::Block, std::memory_order_relaxed);
+    for (std::size_t i = 0; i < Latency_buckets; i++) {
+        queue_latency_[i].store(0, std::memory_order_relaxed);
+        write_latency_[i].store(0, std::memory_order_relaxed);
+    }
+    for (std::size_t i = 0; i < Crash_slots; i++) {
+        crash_producers_[i].store(nullptr, std::memory_order_relaxed);
+        crash_batches_[i].store(nullptr, std::memory_order_relaxed);
+        crash_lanes_[i].store(nullptr, std::memory_order_relaxed);
+    }
 
     add_output(std::this_thread::get_id(), Logger_async::Log_type::Console);
     add_output(std::this_thread::get_id(), Logger_async::Log_type::FileLog);
-    messages_queue.push_back(std::make_pair(std::this_thread::get_id(), Lg_START));
+    enqueue(std::this_thread::get_id(), find_slot(std::this_thread::get_id()), Logger_clock::now(), LogLevel::INFO, false, Lg_START.data(), Lg_START.size(), Overload_policy::Block);
     stop_daemon = false;
     daemonthread_ = std::thread(&Logger_async::daemon_thread, this);
 }
@@ -17,39 +56,133 @@ Logger_async::Logger_async() {
  * @brief Destructor of the logger, stop the daemon thread.
  */
 Logger_async::~Logger_async() {
+    disable_crash_flush();
     if (daemonthread_.joinable())
     {
-        std::lock_guard<std::mutex> lock(mutexlock_);
-        messages_queue.push_back(std::make_pair(std::this_thread::get_id(), Lg_STOP));
+        enqueue(std::this_thread::get_id(), find_slot(std::this_thread::get_id()), Logger_clock::now(), LogLevel::INFO, false, Lg_STOP.data(), Lg_STOP.size(), Overload_policy::Block);
+        daemonthread_.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(producers_mutex_);
+        for (auto& producer : producers_) {
+            producer->hazard.store(nullptr, std::memory_order_release);
+            producer->retired.store(true, std::memory_order_release);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(routes_mutex_);
+        for (const Routing_table* table : retired_routes_)
+            delete table;
+        delete routes_.load(std::memory_order_acquire);
+    }
+
+    delete batch_;
+    for (Batch* batch : batch_pool_)
+        delete batch;
+}
+
+/**
+ * @brief Release the rings of an exiting thread so other threads can reuse them.
+ */
+Logger_async::Producer_cache::~Producer_cache() {
+    for (auto& entry : entries) {
+        entry.second->hazard.store(nullptr, std::memory_order_release);
+        entry.second->orphaned.store(true, std::memory_order_release);
     }
-    condition_.notify_all();
-    daemonthread_.join();
 }
 
 /**
-* @brief            Write a log message to the console.
+* @brief            Setting up a console output.
+* @param stderr_level Lowest level written to stderr; messages logged without a level count as INFO.
+*/
+Logger_async::Console_Log::Console_Log(LogLevel stderr_level) : stderr_level_(stderr_level) {
+#ifdef _WIN32
+    out_.fd = _fileno(stdout);
+    err_.fd = _fileno(stderr);
+    out_.tty = _isatty(out_.fd) != 0;
+    err_.tty = _isatty(err_.fd) != 0;
+#else
+    out_.fd = STDOUT_FILENO;
+    err_.fd = STDERR_FILENO;
+    out_.tty = isatty(out_.fd) != 0;
+    err_.tty = isatty(err_.fd) != 0;
+#endif
+    if (!out_.tty) out_.buffer.reserve(Block_size);
+    if (!err_.tty) err_.buffer.reserve(Block_size);
+}
+
+/**
+* @brief            Destructor of the console output - Write out what is still buffered.
+*/
+Logger_async::Console_Log::~Console_Log(){
+    flush();
+}
+
+/**
+* @brief            Write a text that is not a log entry, such as a lane's overload report, to stdout.
 * @param message    The log message to write.
 */
 void Logger_async::Console_Log::write_log(const std::string& message)  {
-    std::cout << message << std::endl;
+    append(out_, message);
 }
 
 /**
-* @brief            Setting up a file output.
-* @param filename   The name of the file to output to.
-* @param append_    Set mode for output - delete old text or append text.
+* @brief            Write a log message to stdout, or to stderr if its level is high enough.
+* @param entry      The message to write.
 */
-Logger_async::File_Log::File_Log(std::string& filename, bool append_) {
-    if (filename == "") filename = "logs/log.txt";
-    if (append_) file_.open(filename, std::ios::out | std::ios::app);
-    else         file_.open(filename);
+void Logger_async::Console_Log::write_record(const Log_entry& entry) {
+    bool error = entry.has_level && entry.level >= stderr_level_;
+    append(error ? err_ : out_, entry.line());
 }
 
 /**
-* @brief            Destructor of the output streams - Close the file.
+* @brief            Write all buffered messages to the console at once.
 */
-Logger_async::File_Log::~File_Log(){
-    file_.close();
+void Logger_async::Console_Log::flush() {
+    write_out(out_);
+    write_out(err_);
+}
+
+/**
+* @brief            Write what is buffered for both streams from a fatal signal handler; write_out() only calls write().
+*/
+void Logger_async::Console_Log::crash_flush() {
+    write_out(out_);
+    write_out(err_);
+}
+
+/**
+* @brief            Buffer a line, writing the buffer out if the stream is a terminal or a block is full.
+*/
+void Logger_async::Console_Log::append(Stream& stream, const std::string& line) {
+    stream.buffer.append(line);
+    stream.buffer.push_back('\n');
+    if (stream.tty || stream.buffer.size() >= Block_size) write_out(stream);
+}
+
+/**
+* @brief            Write the buffer of a stream with as few write() calls as the descriptor allows.
+*
+* A descriptor that fails (closed, or a reader that went away) loses the text rather than stalling the lane.
+*/
+void Logger_async::Console_Log::write_out(Stream& stream) {
+    Logger_crash::write_all(stream.fd, stream.buffer.data(), stream.buffer.size());
+    stream.buffer.clear();
+}
+
+/**
+* @brief            Setting up a file output.
+* @param filename   The name of the file to output to.
+* @param append_    Set mode for output - delete old text or append text.
+* @param backend    How buffered lines are written to the file.
+* @param rotation   When to start a new file, and what to do with the old ones; no rotation by default.
+*/
+Logger_async::File_Log::File_Log(std::string& filename, bool append_, Logger_file::Backend backend, const Logger_rotation::Policy& rotation)
+    : path_(filename == "" ? filename = "logs/log.txt" : filename), backend_(backend),
+      file_(new Logger_file(path_, append_, backend)), rotation_(path_, rotation) {
+    report_rotation();
 }
 
 /**
@@ -57,49 +190,334 @@ Logger_async::File_Log::~File_Log(){
 * @param message    The log message to write.
 */
 void Logger_async::File_Log::write_log(const std::string& message) {
-    file_ << message << std::endl;
+    if (rotation_.enabled() && rotation_.due(file_->size(), message.size() + 1)) rotate();
+    file_->append(message);
+    file_->append("\n", 1);
+}
+
+/**
+* @brief            Write all buffered messages to the file in one batch.
+*/
+void Logger_async::File_Log::flush() {
+    file_->flush();
+}
+
+/**
+* @brief            Write the buffered messages from a fatal signal handler.
+*/
+void Logger_async::File_Log::crash_flush() {
+    if (file_) file_->crash_flush();
+}
+
+/**
+* @brief            Rename the file to a segment and start the path again.
+*
+* Runs on the output's lane, which only pays for the rename and the open; flushing and closing the
+* segment, compressing and pruning are left to the rotation's thread. Lines still buffered for the
+* segment are lost if the process crashes before that thread has flushed them.
+*/
+void Logger_async::File_Log::rotate() {
+#ifdef _WIN32
+    file_.reset();      // An open file cannot be renamed
+#endif
+    rotation_.rotate(file_);
+    if (!file_) file_.reset(new Logger_file(path_, true, backend_));
+    report_rotation();
+}
+
+/**
+* @brief            Write the rotation's warning, if any, to the file as a line of the logger's own.
+*/
+void Logger_async::File_Log::report_rotation() {
+    std::string warning = rotation_.take_warning();
+    if (warning.empty()) return;
+
+    Logger_time_formatter formatter;
+    char time_text[Logger_time_formatter::Max_length];
+    std::size_t time_length = formatter.format(Logger_clock::now(), time_text);
+    std::string line;
+    line.assign("[").append(time_text, time_length).append("] - [Logger]\t- Logger rotation: ").append(warning).append("\n");
+    file_->append(line);
 }
 
 /**
 * @brief            Setting up a CSV file output.
 * @param filename   The name of the CSV file to output to.
 * @param append_    Set mode for output - delete old text or append text.
+* @param backend    How buffered rows are written to the file.
+*/
+Logger_async::CSV_Log::CSV_Log(std::string& filename, bool append_, Logger_file::Backend backend)
+    : file_(filename == "" ? filename = "logs/log.csv" : filename, append_, backend) {
+    if (file_.size() == 0) file_.append("time,thread,level,message\n");
+}
+
+/**
+* @brief            Write a text that is not a log entry, such as a lane's overload report, as a row
+*                   with only the message field.
+* @param message    The text to write.
+*/
+void Logger_async::CSV_Log::write_log(const std::string& message) {
+    row_.assign(",,,");
+    Logger_args::append_csv_field(message, row_);
+    row_.push_back('\n');
+    file_.append(row_);
+}
+
+/**
+* @brief            Write a row from the fields of a log entry.
+* @param entry      The entry to write.
+*/
+void Logger_async::CSV_Log::write_record(const Log_entry& entry) {
+    char time_text[Logger_time_formatter::Max_length];
+    row_.clear();
+    Logger_args::append_csv_field(time_text, entry.format_time(time_text), row_);
+    row_.push_back(',');
+    Logger_args::append_csv_field(entry.thread_text(), row_);
+    row_.push_back(',');
+    if (entry.has_level) row_.append(Logger_binary::Level_names[static_cast<int>(entry.level)]);
+    row_.push_back(',');
+    Logger_args::append_csv_field(entry.message(), row_);
+    row_.push_back('\n');
+    file_.append(row_);
+}
+
+/**
+* @brief            Write all buffered rows to the CSV file in one batch.
+*/
+void Logger_async::CSV_Log::flush() {
+    file_.flush();
+}
+
+/**
+* @brief            Write the buffered rows from a fatal signal handler.
+*/
+void Logger_async::CSV_Log::crash_flush() {
+    file_.crash_flush();
+}
+
+/**
+* @brief            Setting up a JSON Lines file output.
+* @param filename   The name of the file to output to.
+* @param append_    Set mode for output - delete old objects or append objects.
+* @param backend    How buffered objects are written to the file.
+*/
+Logger_async::Json_Log::Json_Log(std::string& filename, bool append_, Logger_file::Backend backend)
+    : file_(filename == "" ? filename = "logs/log.jsonl" : filename, append_, backend) {
+}
+
+/**
+* @brief            Write a text that is not a log entry, such as a lane's overload report, as an object
+*                   with only the message member.
+* @param message    The text to write.
+*/
+void Logger_async::Json_Log::write_log(const std::string& message) {
+    row_.assign("{\"message\":");
+    Logger_args::append_json_string(message, row_);
+    row_.append("}\n");
+    file_.append(row_);
+}
+
+/**
+* @brief            Write an object from the fields of a log entry.
+* @param entry      The entry to write.
+*/
+void Logger_async::Json_Log::write_record(const Log_entry& entry) {
+    char time_text[Logger_time_formatter::Max_length];
+    row_.assign("{\"ts_ns\":");
+    Logger_args::append_int(entry.wall_ns(), row_);
+    row_.append(",\"time\":");
+    Logger_args::append_json_string(time_text, entry.format_time(time_text), row_);
+    row_.append(",\"thread\":");
+    Logger_args::append_json_string(entry.thread_text(), row_);
+    if (entry.has_level) row_.append(",\"level\":\"").append(Logger_binary::Level_names[static_cast<int>(entry.level)]).push_back('"');
+    row_.append(",\"message\":");
+    if (!entry.format) {
+        Logger_args::append_json_string(entry.message(), row_);
+    }
+    else {
+        message_.clear();
+        Logger_args::render(entry.format, entry.args, entry.args_size, message_, false);
+        Logger_args::append_json_string(message_, row_);
+
+        const unsigned char* end = entry.args + entry.args_size;
+        for (const unsigned char* arg = entry.args; arg && arg < end; arg = Logger_args::skip_arg(arg, end)) {
+            const char* key;
+            std::uint32_t key_length;
+            const unsigned char* value = Logger_args::field_key(arg, end, key, key_length);
+            if (!value) continue;
+            row_.push_back(',');
+            Logger_args::append_json_string(key, key_length, row_);
+            row_.push_back(':');
+            Logger_args::append_json_arg(value, end, row_);
+        }
+    }
+    row_.append("}\n");
+    file_.append(row_);
+}
+
+/**
+* @brief            Write all buffered objects to the file in one batch.
+*/
+void Logger_async::Json_Log::flush() {
+    file_.flush();
+}
+
+/**
+* @brief            Write the buffered objects from a fatal signal handler.
+*/
+void Logger_async::Json_Log::crash_flush() {
+    file_.crash_flush();
+}
+
+/**
+* @brief            Setting up a binary file output.
+* @param filename   The name of the binary file to output to.
+* @param append_    Set mode for output - delete old records or append records.
 */
-Logger_async::CSV_Log::CSV_Log(std::string& filename, bool append_) {
-    if (filename == "") filename = "logs/log.csv";
-    if (append_) file_.open(filename, std::ios::out | std::ios::app);
-    else         file_.open(filename);
+Logger_async::Binary_Log::Binary_Log(std::string& filename, bool append_) {
+    if (filename == "") filename = "logs/log.bin";
+    path_ = filename;
+
+    bool has_header = false;
+    if (append_) {
+        // A file of an older layout gets a new header, which starts a new section for the decoder.
+        char magic[sizeof(Logger_binary::Magic)];
+        std::ifstream existing(filename, std::ios::in | std::ios::binary);
+        has_header = existing.read(magic, sizeof(magic)) && std::memcmp(magic, Logger_binary::Magic, sizeof(magic)) == 0;
+        file_.open(filename, std::ios::out | std::ios::app | std::ios::binary);
+    }
+    else {
+        file_.open(filename, std::ios::out | std::ios::trunc | std::ios::binary);
+    }
+    if (!has_header) buffer_.append(Logger_binary::Magic, sizeof(Logger_binary::Magic));
 }
 
 /**
 * @brief            Destructor of the output streams - Close the file.
 */
-Logger_async::CSV_Log::~CSV_Log(){
+Logger_async::Binary_Log::~Binary_Log(){
+    flush();
     file_.close();
 }
 
 /**
-* @brief            Write a log message and value to the CSV file.
+* @brief            Store a finished text line as a message of the plain text format.
 * @param message    The log message to write.
 */
-void Logger_async::CSV_Log::write_log(const std::string& message) {
-    std::vector<std::string> data = Logger_async::CSV_Log::split(message,'-');
-    file_ << data[0] << "," << data[1] << "," << data[2] << std::endl;
+void Logger_async::Binary_Log::write_log(const std::string& message) {
+    scratch_.resize(Logger_args::size_of(message));
+    Logger_args::encode(reinterpret_cast<unsigned char*>(&scratch_[0]), message);
+    std::int64_t wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    put_record(format_id(Logger_binary::Text_format), wall_ns, thread_key(std::thread::id(), nullptr), level_byte(LogLevel::INFO, false),
+               reinterpret_cast<const unsigned char*>(scratch_.data()), static_cast<std::uint32_t>(scratch_.size()));
 }
 
 /**
-* @brief                Slipt string to small parts.
-* @param s              A string needs to be slipted.
-* @param delimiter      Seperator.
+* @brief            Store the format ID, time, thread ID and raw arguments of a message.
+* @param entry      The message to write.
 */
-std::vector<std::string> Logger_async::CSV_Log::split(const std::string& message, char delimiter) {
-    std::vector<std::string> data;
-    std::string token;
-    std::stringstream tokenStream(message);
-    while (std::getline(tokenStream, token, delimiter)) {
-        data.push_back(token);
+void Logger_async::Binary_Log::write_record(const Log_entry& entry) {
+    std::uint32_t thread = thread_key(entry.thread_id, &entry);
+    unsigned char level = level_byte(entry.level, entry.has_level);
+    if (entry.format) {
+        put_record(format_id(entry.format), entry.wall_ns(), thread, level, entry.args, entry.args_size);
+        return;
     }
-    return data;
+    const std::string& message = entry.message();
+    scratch_.resize(Logger_args::size_of(message));
+    Logger_args::encode(reinterpret_cast<unsigned char*>(&scratch_[0]), message);
+    put_record(format_id(Logger_binary::Text_format), entry.wall_ns(), thread, level,
+               reinterpret_cast<const unsigned char*>(scratch_.data()), static_cast<std::uint32_t>(scratch_.size()));
+}
+
+/**
+* @brief            Write all buffered records to the file with one write and one flush.
+*/
+void Logger_async::Binary_Log::flush() {
+    if (buffer_.empty()) return;
+    file_.write(buffer_.data(), buffer_.size());
+    file_.flush();
+    buffer_.clear();
+}
+
+/**
+* @brief            Write the buffered records from a fatal signal handler, through a descriptor of
+*                   its own as the std::ofstream may not be used there.
+*/
+void Logger_async::Binary_Log::crash_flush() {
+    if (buffer_.empty()) return;
+    int fd = Logger_crash::open_append(path_.c_str());
+    Logger_crash::write_all(fd, buffer_.data(), buffer_.size());
+    Logger_crash::close_file(fd);
+    buffer_.clear();
+}
+
+/**
+* @brief            ID of a format string, adding it to the file's dictionary the first time it is seen.
+* @param format     Static format string of the message.
+*/
+std::uint32_t Logger_async::Binary_Log::format_id(const char* format) {
+    auto search = formats_.find(format);
+    if (search != formats_.end()) return search->second;
+
+    std::uint32_t id = static_cast<std::uint32_t>(formats_.size());
+    formats_.insert(std::make_pair(format, id));
+    put_definition(Logger_binary::Format_def, id, format, std::strlen(format));
+    return id;
+}
+
+/**
+* @brief            ID of a thread, adding its name to the file's dictionary the first time it is seen.
+* @param thread_id  Id of the thread that logged the message.
+* @param entry      The message, used for the thread's name as it appears in text logs; may be nullptr.
+*/
+std::uint32_t Logger_async::Binary_Log::thread_key(std::thread::id thread_id, const Log_entry* entry) {
+    auto search = threads_.find(thread_id);
+    if (search != threads_.end()) return search->second;
+
+    std::uint32_t id = static_cast<std::uint32_t>(threads_.size());
+    threads_.insert(std::make_pair(thread_id, id));
+    std::string text = entry ? entry->thread_text() : std::string();
+    put_definition(Logger_binary::Thread_def, id, text.data(), text.size());
+    return id;
+}
+
+/**
+* @brief            Append a dictionary block.
+*/
+void Logger_async::Binary_Log::put_definition(unsigned char tag, std::uint32_t id, const char* text, std::size_t length) {
+    buffer_.push_back(static_cast<char>(tag));
+    put(id);
+    put(static_cast<std::uint32_t>(length));
+    buffer_.append(text, length);
+}
+
+/**
+* @brief            Level byte of a record - the level's index, plus Level_tagged if it was given explicitly.
+*/
+unsigned char Logger_async::Binary_Log::level_byte(LogLevel level, bool has_level) {
+    return static_cast<unsigned char>(static_cast<int>(level) | (has_level ? Logger_binary::Level_tagged : 0));
+}
+
+/**
+* @brief            Append a record block.
+*/
+void Logger_async::Binary_Log::put_record(std::uint32_t format, std::int64_t wall_ns, std::uint32_t thread, unsigned char level, const unsigned char* args, std::uint32_t args_size) {
+    buffer_.push_back(static_cast<char>(Logger_binary::Record));
+    put(format);
+    put(wall_ns);
+    put(thread);
+    put(level);
+    put(args_size);
+    buffer_.append(reinterpret_cast<const char*>(args), args_size);
+}
+
+/**
+* @brief            Append the raw bytes of an integer.
+*/
+template <typename T> void Logger_async::Binary_Log::put(T value) {
+    buffer_.append(reinterpret_cast<const char*>(&value), sizeof(value));
 }
 
 /**
@@ -108,116 +526,1645 @@ std::vector<std::string> Logger_async::CSV_Log::split(const std::string& message
  * @param _log          The log type.
  * @param path          The file of path if log type is file output.
  * @param append_       Set mode for output - delete old text or append text.
+ *
+ * Threads that name the same file (after resolving the path) share one output, and with it one
+ * buffer, one descriptor and one write stream. The first registration of a file decides whether it
+ * is truncated; later ones join the open output whatever append_ says.
  */
 void Logger_async::add_output(std::thread::id thread_id, Log_type _log, std::string path, bool append_) {
-    std::shared_ptr<Output> _output = NULL;
+    std::shared_ptr<Output> _output = open_output(_log, path, append_);
+    update_routes(thread_id, &_output);
+}
+
+/**
+ * @brief               Interface method - Add an output the caller has set up, e.g. with non-default options.
+ * @param thread_id     Id of the thread needs to be logged.
+ * @param output        The output; it may be shared with other threads or loggers' threads.
+ */
+void Logger_async::add_output(std::thread::id thread_id, std::shared_ptr<Output> output) {
+    update_routes(thread_id, &output);
+}
 
+/**
+ * @brief               Return the live output for a log type and file, creating it if nobody has it open.
+ * @param _log          The log type.
+ * @param path          The file of path if log type is file output.
+ * @param append_       Set mode for output if the file has to be opened.
+ */
+std::shared_ptr<Logger_async::Output> Logger_async::open_output(Log_type _log, std::string path, bool append_) {
+    if (path == "") {
+        if (_log == Log_type::FileLog)        path = "logs/log.txt";
+        else if (_log == Log_type::CSVLog)    path = "logs/log.csv";
+        else if (_log == Log_type::BinaryLog) path = "logs/log.bin";
+        else if (_log == Log_type::MmapLog)   path = "logs/log_mmap.txt";
+        else if (_log == Log_type::JsonLog)   path = "logs/log.jsonl";
+    }
+    std::string key = convert_to_str(static_cast<int>(_log)) + ":" + (_log == Log_type::Console ? "" : canonical_path(path));
+
+    std::lock_guard<std::mutex> lock(shared_outputs_mutex_);
+    for (auto it = shared_outputs_.begin(); it != shared_outputs_.end();) {
+        if (it->second.expired()) it = shared_outputs_.erase(it);
+        else ++it;
+    }
+
+    auto search = shared_outputs_.find(key);
+    if (search != shared_outputs_.end()) return search->second.lock();
+
+    std::shared_ptr<Output> _output = NULL;
     if (_log == Log_type::Console)
         _output = std::make_shared<Console_Log>();
     else if (_log == Log_type::FileLog)
         _output = std::make_shared<File_Log>(path, append_);
     else if (_log == Log_type::CSVLog)
         _output = std::make_shared<CSV_Log>(path, append_);
+    else if (_log == Log_type::BinaryLog)
+        _output = std::make_shared<Binary_Log>(path, append_);
+    else if (_log == Log_type::MmapLog)
+        _output = std::make_shared<Mmap_Log>(path, append_);
+    else if (_log == Log_type::JsonLog)
+        _output = std::make_shared<Json_Log>(path, append_);
 
-    std::lock_guard<std::mutex> lock(mutexlock_);
-    auto search = outputs_.find(thread_id);
+    shared_outputs_[key] = _output;
+    return _output;
+}
 
-    if (search != outputs_.end()) {
-        search->second.push_back(std::move(_output));
-    }
-    else {
-        std::vector<std::shared_ptr<Output>> thread_output_type;
-        thread_output_type.push_back(_output);
-        outputs_.insert(std::make_pair(thread_id, std::move(thread_output_type)));
-    }
+/**
+ * @brief               Absolute, normalised form of a file path, used to recognise the same file.
+ * @param path          Path as given by the caller; the file itself does not have to exist yet.
+ */
+std::string Logger_async::canonical_path(const std::string& path) {
+#ifdef _WIN32
+    char resolved[_MAX_PATH];
+    if (_fullpath(resolved, path.c_str(), _MAX_PATH) == NULL) return path;
+    std::string result(resolved);
+    std::replace(result.begin(), result.end(), '/', '\\');
+    std::transform(result.begin(), result.end(), result.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+    return result;
+#else
+    std::size_t slash = path.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+
+    char resolved[PATH_MAX];
+    if (realpath(directory.c_str(), resolved) == NULL) return path;
+    std::string result(resolved);
+    if (result != "/") result.push_back('/');
+    return result + name;
+#endif
 }
 
 /**
  * @brief               Log a message.
  * @param thread_id     Id of the thread needs to be logged.
- * @param message       The message to log.
+ * @param message       The message to log; copied into the queued record, whose buffer is reused.
  */
-bool Logger_async::add_log(std::thread::id thread_id, std::string message) {
-    std::lock_guard<std::mutex> lock(mutexlock_);
-    auto search = outputs_.find(thread_id);
-    if (search != outputs_.end()) {
-        messages_queue.push_back(std::make_pair(thread_id, message));
-        condition_.notify_one();
-        return true;
-    }
-    else {
-        std::cout << "Thread [" << convert_to_str(thread_id) << ("] Error while trying to log message! Check if output method is registered or not.\n");
-        condition_.notify_one();
-        return false;
-    }
+bool Logger_async::add_log(std::thread::id thread_id, const char* message) {
+    std::uint64_t tick = Logger_clock::now();
+    std::uint32_t slot = registered_slot(thread_id);
+    if (slot == No_slot) return false;
+    Overload_policy policy = overload_policies_[static_cast<int>(LogLevel::INFO)].load(std::memory_order_relaxed);
+    return enqueue(thread_id, slot, tick, LogLevel::INFO, false, message ? message : "", message ? std::strlen(message) : 0, policy);
 }
 
 /**
  * @brief               Log a message.
  * @param thread_id     Id of the thread needs to be logged.
+ * @param message       The message to log; copied into the queued record, whose buffer is reused.
+ */
+bool Logger_async::add_log(std::thread::id thread_id, const std::string& message) {
+    std::uint64_t tick = Logger_clock::now();
+    std::uint32_t slot = registered_slot(thread_id);
+    if (slot == No_slot) return false;
+    Overload_policy policy = overload_policies_[static_cast<int>(LogLevel::INFO)].load(std::memory_order_relaxed);
+    return enqueue(thread_id, slot, tick, LogLevel::INFO, false, message.data(), message.size(), policy);
+}
+
+/**
+ * @brief               Log a message of a given level.
+ * @param thread_id     Id of the thread needs to be logged.
+ * @param level         Severity; nothing is done if it is below the logger's level.
+ * @param message       The message to log; copied into the queued record, whose buffer is reused.
+ */
+bool Logger_async::add_log(std::thread::id thread_id, LogLevel level, const std::string& message) {
+    if (!should_log(level)) return false;
+    std::uint64_t tick = Logger_clock::now();
+    std::uint32_t slot = registered_slot(thread_id);
+    if (slot == No_slot) return false;
+    Overload_policy policy = overload_policies_[static_cast<int>(level)].load(std::memory_order_relaxed);
+    return enqueue(thread_id, slot, tick, level, true, message.data(), message.size(), policy);
+}
+
+/**
+ * @brief               Remove every output of a thread, after the messages logged for it so far.
+ * @param thread_id     Id of the thread whose outputs are removed.
+ *
+ * Messages logged for the thread by any thread before this call are written first, then a
+ * "Thread_RM" line. The position of every ring is recorded here; the daemon waits until it has
+ * taken each ring up to that position before it applies the removal.
  */
 void Logger_async::remove_thread_ouput(std::thread::id thread_id) {
-    std::lock_guard<std::mutex> lock(mutexlock_);
-    messages_queue.push_back(std::make_pair(thread_id, Thread_REMOVE));
-    condition_.notify_one();
+    Removal removal;
+    removal.thread_id = thread_id;
+    removal.tick = Logger_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(producers_mutex_);
+        for (auto& producer : producers_)
+            removal.marks.push_back(std::make_pair(producer, producer->ring.pushed()));
+    }
+    {
+        std::lock_guard<std::mutex> lock(removals_mutex_);
+        removals_.push_back(std::move(removal));
+        removals_pending_.store(true, std::memory_order_release);
+    }
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (daemon_sleeping_.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        condition_.notify_one();
+    }
 }
 
 /**
- * @brief          Convert all data type to string.
- * @param data     Data needs to be converted.
+ * @brief               Set the lowest level that is logged; add_log() calls below it return at once.
+ * @param level         The new threshold. Messages logged without a level count as INFO.
  */
-template <typename T> std::string Logger_async::convert_to_str(T data) {
-    std::stringstream strm;
-    strm << data;
-    return strm.str();
+void Logger_async::set_log_level(LogLevel level) {
+    log_level_.store(level, std::memory_order_relaxed);
 }
 
 /**
- * @brief  Get the current time.
+ * @brief               The lowest level that is logged.
  */
-std::string Logger_async::get_time() {
-    time_t current_time = time(0);
+Logger_async::LogLevel Logger_async::log_level() const {
+    return log_level_.load(std::memory_order_relaxed);
+}
 
-    char time_str[26];
-    errno_t error = ctime_s(time_str, sizeof(time_str), &current_time);
+/**
+ * @brief               Fold identical consecutive messages of a thread into a count, or stop doing so.
+ * @param enabled       True to fold them; false writes the counts held back and every message from then on.
+ *
+ * The first of a run of identical messages - same text or format and arguments, same level - is
+ * written as usual. The copies after it are only counted, and written as one "Last message repeated
+ * N times between <first> and <last>" line when the thread logs something else, about once a
+ * second while the run lasts, at flush() and when the thread's outputs are removed.
+ */
+void Logger_async::set_compaction(bool enabled) {
+    compaction_.store(enabled, std::memory_order_relaxed);
+}
 
-    std::string time_ = convert_to_str(time_str);
-    time_.pop_back();
+/**
+ * @brief               Show a thread in log lines by a name, e.g. "worker-7", instead of its numeric id.
+ * @param thread_id     Id of the thread; it need not have outputs yet.
+ * @param name          The name, used for the messages the daemon handles from now on.
+ *
+ * The name outlives the thread's outputs: it is used again if outputs are added back later.
+ */
+void Logger_async::set_thread_name(std::thread::id thread_id, std::string name) {
+    update_routes(thread_id, nullptr, &name);
+}
 
-    return time_;
+/**
+ * @brief               Choose when the daemon flushes the outputs it has written to.
+ * @param policy        Flush after every batch, every value milliseconds or every value bytes.
+ * @param value         Interval in milliseconds or threshold in bytes; ignored for Per_batch.
+ */
+void Logger_async::set_flush_policy(Flush_policy policy, std::size_t value) {
+    flush_value_.store(value, std::memory_order_relaxed);
+    flush_policy_.store(policy, std::memory_order_release);
 }
 
 /**
- * @brief  Daemon thread for outputting log messages.
+ * @brief               Choose what producers do when their queue is full, for messages of every level.
+ * @param policy        Block, drop the new message, drop the oldest queued one, or spill to a file.
+ * @param spill_path    File the Spill policy appends to; "logs/log_spill.txt" if empty.
+ *
+ * Control messages (output removal, logger start and stop) always block and are never dropped.
  */
-void Logger_async::daemon_thread() {
-    while (!stop_daemon) {
-        std::unique_lock<std::mutex> lock(mutexlock_);
-        condition_.wait(lock, [&] { return !messages_queue.empty(); });
-
-        std::pair<std::thread::id, std::string> message = messages_queue.front();
-        messages_queue.pop_front();
-        lock.unlock();
-        
-        std::string log_message = "[" + get_time() + "] - "+
-                                    "[" + convert_to_str(message.first) + "]"
-                                    +"\t- " + convert_to_str(message.second);
-
-        std::lock_guard<std::mutex> output_lock(mutexlock_);
-        std::unordered_map<std::thread::id, std::vector<std::shared_ptr<Output>>>::iterator search = outputs_.find(message.first);
-        if (search != outputs_.end()) {
-            for (std::shared_ptr<Output> output : search->second) {
-                output->write_log(log_message);
-            }
-            if (message.second == Thread_REMOVE)
-            {
-                outputs_.erase(message.first);
-            }
-        }
+void Logger_async::set_overload_policy(Overload_policy policy, std::string spill_path) {
+    for (std::size_t level = 0; level < Level_count; level++)
+        set_overload_policy(static_cast<LogLevel>(level), policy, spill_path);
+}
 
-        if (message.second == Lg_STOP)
-        {
-            stop_daemon=true;
-        }
+/**
+ * @brief               Choose what producers do when their queue is full, for messages of one level.
+ * @param level         The level the policy applies to, e.g. drop DEBUG but block for ERROR.
+ * @param policy        Block, drop the new message, drop the oldest queued one, or spill to a file.
+ * @param spill_path    File the Spill policy appends to; "logs/log_spill.txt" if empty. All levels
+ *                      share one spill file.
+ *
+ * Drop_oldest discards the oldest queued message whatever its level.
+ */
+void Logger_async::set_overload_policy(LogLevel level, Overload_policy policy, std::string spill_path) {
+    if (policy == Overload_policy::Spill) {
+        if (spill_path == "") spill_path = "logs/log_spill.txt";
+        std::lock_guard<std::mutex> lock(spill_mutex_);
+        if (!spill_file_ || spill_path_ != spill_path) spill_file_.reset(new Logger_file(spill_path, true));
+        spill_path_ = spill_path;
     }
-}
\ No newline at end of file
+    overload_policies_[static_cast<int>(level)].store(policy, std::memory_order_release);
+}
+
+/**
+ * @brief               Set how many messages may wait for one output before its overload policy applies.
+ * @param capacity      Queued messages per output; Default_lane_capacity unless set.
+ *
+ * When an output falls that far behind, the threads routed to it block or spill their messages
+ * whose level blocks or spills on overload until it catches up; messages whose level drops are
+ * dropped and counted in the output's stats. Other outputs go on as before. Messages already queued
+ * when the output filled up are still given to it, so its backlog can pass the capacity by what the
+ * rings of those threads hold.
+ */
+void Logger_async::set_lane_capacity(std::size_t capacity) {
+    lane_capacity_.store(capacity, std::memory_order_relaxed);
+}
+
+/**
+ * @brief               Block until every message queued before the call, by any thread, has been
+ *                      written and flushed by all outputs.
+ *
+ * Must not be called from an output, whose lane would then wait for itself.
+ */
+void Logger_async::flush() {
+    flush_async().wait();
+}
+
+/**
+ * @brief               Block until every message queued before the call has been written and flushed
+ *                      by the outputs of one thread.
+ * @param thread_id     Thread whose outputs are flushed; returns at once if it has none.
+ */
+void Logger_async::flush(std::thread::id thread_id) {
+    flush_async(thread_id).wait();
+}
+
+/**
+ * @brief               Like flush(), but return at once with a future that becomes ready then.
+ */
+std::future<void> Logger_async::flush_async() {
+    return request_flush(std::thread::id(), true);
+}
+
+/**
+ * @brief               Like flush(thread_id), but return at once with a future that becomes ready then.
+ */
+std::future<void> Logger_async::flush_async(std::thread::id thread_id) {
+    return request_flush(thread_id, false);
+}
+
+/**
+ * @brief               Interface method - Save what the logger holds when the process crashes.
+ * @param path          File that messages no output has written yet are appended to; "logs/crash.txt" if empty.
+ * @return              False if Logger_crash has no room for another logger.
+ *
+ * Installs the handlers of Logger_crash for SIGSEGV, SIGABRT, SIGBUS, SIGFPE and std::terminate.
+ * When one fires, every output writes what it has buffered (Output::crash_flush()), and messages
+ * still queued - for a lane, in the daemon's batch or in a producer's ring - are appended to path
+ * as text lines with UTC times, so lazy flush policies and large buffers lose next to nothing on a
+ * crash; crash_flush() lists what can still be lost.
+ */
+bool Logger_async::enable_crash_flush(std::string path) {
+    disable_crash_flush();
+    crash_path_ = path == "" ? "logs/crash.txt" : path;
+    crash_message_.reserve(Crash_render_size);
+    Logger_crash::install();
+    return Logger_crash::add(&Logger_async::crash_handler, this);
+}
+
+/**
+ * @brief               Interface method - Stop saving the logger's messages on a crash; the signal handlers stay.
+ */
+void Logger_async::disable_crash_flush() {
+    Logger_crash::remove(&Logger_async::crash_handler, this);
+}
+
+/**
+ * @brief               Read the logger's counters: queue depth, drops, latency histograms and the work of every output.
+ *
+ * Safe to call from any thread while messages are logged; nothing is reset.
+ */
+Logger_async::Stats Logger_async::stats() {
+    Stats stats;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - created_).count();
+    std::uint64_t handled = handled_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_total_.load(std::memory_order_relaxed);
+    stats.spilled = spilled_total_.load(std::memory_order_relaxed);
+    stats.queue_depth = 0;
+    {
+        std::lock_guard<std::mutex> lock(producers_mutex_);
+        for (auto& producer : producers_) {
+            stats.queue_depth += producer->ring.size();
+            stats.dropped += producer->dropped.load(std::memory_order_relaxed);
+            stats.spilled += producer->spilled.load(std::memory_order_relaxed);
+        }
+    }
+    stats.enqueued = handled + stats.queue_depth;
+    stats.max_queue_depth = max_queue_depth_.load(std::memory_order_relaxed);
+    stats.suppressed = suppressed_total_.load(std::memory_order_relaxed);
+    stats.folded = folded_.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < Latency_buckets; i++) {
+        stats.queue_latency[i] = queue_latency_[i].load(std::memory_order_relaxed);
+        stats.write_latency[i] = write_latency_[i].load(std::memory_order_relaxed);
+    }
+
+    // Tables are only replaced and freed under routes_mutex_, so the current one stays valid while it is held.
+    std::lock_guard<std::mutex> lock(routes_mutex_);
+    for (const Route& route : routes_.load(std::memory_order_acquire)->routes) {
+        for (const std::shared_ptr<Output>& output : route.outputs) {
+            bool listed = false;
+            for (const auto& entry : stats.outputs)
+                listed = listed || entry.first == output.get();
+            if (!listed) stats.outputs.push_back(std::make_pair(output.get(), output->stats()));
+        }
+    }
+    return stats;
+}
+
+/**
+ * @brief               Log the logger's counters to the outputs of a thread every interval, or stop doing so.
+ * @param thread_id     Thread whose outputs get the report - a summary line, then a line per output.
+ * @param interval      Time between reports; zero stops them. The first one is logged at once unless
+ *                      a report went out less than interval ago.
+ */
+void Logger_async::set_stats_report(std::thread::id thread_id, std::chrono::milliseconds interval) {
+    stats_to_.store(thread_id, std::memory_order_relaxed);
+    stats_interval_.store(interval.count() > 0 ? interval.count() : 0, std::memory_order_release);
+
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    condition_.notify_one();
+}
+
+/**
+ * @brief               Upper end, in microseconds, of the bucket that holds a fraction of the latencies counted.
+ * @param buckets       Stats::queue_latency or Stats::write_latency.
+ * @param fraction      0.5 for the median, 0.99 for the 99th percentile.
+ * @return              0 if nothing was counted. Latencies in the last bucket are reported as its lower end.
+ */
+std::uint64_t Logger_async::Stats::percentile(const std::uint64_t (&buckets)[Latency_buckets], double fraction) {
+    std::uint64_t total = 0;
+    for (std::uint64_t count : buckets) total += count;
+    if (total == 0) return 0;
+
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < Latency_buckets; i++) {
+        seen += buckets[i];
+        if (seen >= fraction * total) return std::uint64_t(1) << (i < Latency_buckets - 1 ? i : i - 1);
+    }
+    return std::uint64_t(1) << (Latency_buckets - 2);
+}
+
+/**
+ * @brief               Find the ring owned by the calling thread, registering one on first use.
+ */
+Logger_async::Producer* Logger_async::local_producer() {
+    for (auto& entry : producer_cache_.entries) {
+        if (entry.first == logger_id_) return entry.second.get();
+    }
+    return register_producer();
+}
+
+/**
+ * @brief               Slow path of local_producer() - adopt an orphaned ring or create a new one.
+ */
+Logger_async::Producer* Logger_async::register_producer() {
+    auto& entries = producer_cache_.entries;
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it->second->retired.load(std::memory_order_acquire)) it = entries.erase(it);
+        else ++it;
+    }
+
+    std::shared_ptr<Producer> producer;
+    std::lock_guard<std::mutex> lock(producers_mutex_);
+    for (auto& candidate : producers_) {
+        if (candidate->orphaned.load(std::memory_order_acquire) && candidate->ring.empty()) {
+            candidate->orphaned.store(false, std::memory_order_relaxed);
+            candidate->report_to.store(std::this_thread::get_id(), std::memory_order_relaxed);
+            producer = candidate;
+            break;
+        }
+    }
+    if (!producer) {
+        producer = std::make_shared<Producer>(ring_capacity_);
+        producer->report_to.store(std::this_thread::get_id(), std::memory_order_relaxed);
+        producers_.push_back(producer);
+        producers_version_.fetch_add(1, std::memory_order_release);
+        for (auto& slot : crash_producers_) {
+            if (slot.load(std::memory_order_relaxed)) continue;
+            slot.store(producer.get(), std::memory_order_release);
+            break;
+        }
+    }
+    entries.push_back(std::make_pair(logger_id_, producer));
+    return producer.get();
+}
+
+/**
+ * @brief               Pin the current routing table so it cannot be freed while it is read.
+ * @param hazard        The reader's hazard slot; it keeps protecting the table until overwritten.
+ * @return              The current routing table.
+ *
+ * Writers copy the table, change the copy and swap it in; the old table is freed only once no hazard
+ * slot points at it. Readers therefore never lock and never touch a reference count.
+ */
+const Logger_async::Routing_table* Logger_async::acquire_routes(std::atomic<const Routing_table*>& hazard) {
+    const Routing_table* table = routes_.load(std::memory_order_acquire);
+    while (true) {
+        hazard.store(table, std::memory_order_seq_cst);
+        const Routing_table* current = routes_.load(std::memory_order_seq_cst);
+        if (current == table) return table;
+        table = current;
+    }
+}
+
+/**
+ * @brief               Slot of a thread in a table being built, giving it one if it has none. Needs routes_mutex_.
+ *
+ * A new slot is a free one if any. It starts out with the thread's name, or its id as text,
+ * converted here once rather than per message.
+ */
+std::uint32_t Logger_async::route_slot(Routing_table& table, std::thread::id thread_id) {
+    auto search = table.slots.find(thread_id);
+    if (search != table.slots.end()) return search->second;
+
+    std::uint32_t slot;
+    if (!free_slots_.empty()) {
+        slot = free_slots_.back();
+        free_slots_.pop_back();
+    }
+    else {
+        slot = static_cast<std::uint32_t>(table.routes.size());
+        table.routes.emplace_back();
+    }
+    table.slots.insert(std::make_pair(thread_id, slot));
+
+    Route& route = table.routes[slot];
+    route.thread_id = thread_id;
+    auto name = thread_names_.find(thread_id);
+    if (name != thread_names_.end()) route.text = name->second;
+    else                             route.text = std::make_shared<const std::string>(convert_to_str(thread_id));
+    return slot;
+}
+
+/**
+ * @brief               Publish a copy of the routing table with one output added to, or all removed from, a thread.
+ * @param thread_id     Id of the thread whose outputs change.
+ * @param output        Output to add, or nullptr to remove every output of the thread.
+ * @param name          New text of the thread instead, if not nullptr; its outputs are left alone then.
+ *
+ * Removing the outputs frees the thread's slot. A record still queued with it then no longer
+ * matches the slot's owner and is dropped, as it would have been without the slot. Nothing is
+ * published if a removal or a name leaves the table as it was.
+ */
+void Logger_async::update_routes(std::thread::id thread_id, const std::shared_ptr<Output>* output, const std::string* name) {
+    std::lock_guard<std::mutex> lock(routes_mutex_);
+    const Routing_table* current = routes_.load(std::memory_order_relaxed);
+    if (name) thread_names_[thread_id] = std::make_shared<const std::string>(*name);
+    if (!output && current->slots.find(thread_id) == current->slots.end()) return;
+
+    Routing_table* next = new Routing_table(*current);
+    std::uint32_t slot = route_slot(*next, thread_id);
+    Route& route = next->routes[slot];
+    if (name) {
+        route.text = thread_names_[thread_id];
+    }
+    else if (output) {
+        route.outputs.push_back(*output);
+    }
+    else {
+        next->slots.erase(thread_id);
+        route.thread_id = std::thread::id();
+        route.outputs.clear();
+        route.text.reset();
+        free_slots_.push_back(slot);
+    }
+
+    routes_.store(next, std::memory_order_seq_cst);
+    retired_routes_.push_back(current);
+    reclaim_routes();
+}
+
+/**
+ * @brief               Free retired routing tables that no reader has pinned. Needs routes_mutex_.
+ */
+void Logger_async::reclaim_routes() {
+    std::vector<const Routing_table*> pinned;
+    pinned.push_back(daemon_hazard_.load(std::memory_order_seq_cst));
+    pinned.push_back(crash_hazard_.load(std::memory_order_seq_cst));
+    {
+        std::lock_guard<std::mutex> lock(producers_mutex_);
+        for (auto& producer : producers_)
+            pinned.push_back(producer->hazard.load(std::memory_order_seq_cst));
+    }
+
+    for (auto it = retired_routes_.begin(); it != retired_routes_.end();) {
+        if (std::find(pinned.begin(), pinned.end(), *it) == pinned.end()) {
+            delete *it;
+            it = retired_routes_.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+/**
+ * @brief               Slot of a thread that has outputs, or No_slot.
+ *
+ * The calling thread keeps its hazard on the table it last read, so while the table is unchanged a
+ * lookup is one atomic load and one hash lookup.
+ */
+std::uint32_t Logger_async::find_slot(std::thread::id thread_id) {
+    Producer* producer = local_producer();
+    const Routing_table* routes = producer->hazard.load(std::memory_order_relaxed);
+    if (routes != routes_.load(std::memory_order_acquire))
+        routes = acquire_routes(producer->hazard);
+
+    auto search = routes->slots.find(thread_id);
+    if (search == routes->slots.end() || routes->routes[search->second].outputs.empty()) return No_slot;
+    return search->second;
+}
+
+/**
+ * @brief               Slot of a thread that is logging, reporting it on the console if it has no outputs.
+ * @param thread_id     Id of the thread needs to be logged.
+ * @return              The slot to queue the record with, or No_slot.
+ */
+std::uint32_t Logger_async::registered_slot(std::thread::id thread_id) {
+    std::uint32_t slot = find_slot(thread_id);
+    if (slot == No_slot)
+        std::cout << "Thread [" << convert_to_str(thread_id) << ("] Error while trying to log message! Check if output method is registered or not.\n");
+    return slot;
+}
+
+/**
+ * @brief               Slot of a thread in the daemon's routing table, for records the daemon makes itself.
+ */
+std::uint32_t Logger_async::daemon_slot(std::thread::id thread_id) {
+    if (routes_.load(std::memory_order_acquire) != daemon_routes_)
+        daemon_routes_ = acquire_routes(daemon_hazard_);
+    auto search = daemon_routes_->slots.find(thread_id);
+    return search != daemon_routes_->slots.end() ? search->second : No_slot;
+}
+
+/**
+ * @brief               Reserve the next slot of the calling thread's ring, applying policy while it is full.
+ * @param thread_id     Id of the thread the record is logged for.
+ * @param slot          Routing slot of thread_id, from the table the calling thread's hazard pins.
+ * @param policy        What to do if the ring, or an output the record is routed to, is full.
+ * @return              The record to fill in place and hand over with publish_record(), or nullptr if
+ *                      the record is dropped. Under Spill a full ring or output yields a record outside the ring.
+ *
+ * A full output only holds up records that would wait in its lane anyway; records whose level
+ * drops are dropped there instead.
+ */
+Logger_async::Record* Logger_async::claim_record(std::thread::id thread_id, std::uint32_t slot, Overload_policy policy) {
+    Producer* producer = local_producer();
+    if (policy == Overload_policy::Block || policy == Overload_policy::Spill) {
+        const Routing_table* routes = producer->hazard.load(std::memory_order_relaxed);
+        if (routes && slot < routes->routes.size()) {
+            for (const auto& output : routes->routes[slot].outputs) {
+                if (!output->full_.load(std::memory_order_acquire)) continue;
+                if (policy == Overload_policy::Spill) return &producer->overflow;
+                wait_for_output(*output);
+            }
+        }
+    }
+
+    Record* record;
+    while ((record = producer->ring.try_claim()) == nullptr) {
+        switch (policy) {
+        case Overload_policy::Block:
+            wait_for_room(*producer);
+            break;
+        case Overload_policy::Drop_newest:
+            producer->report_to.store(thread_id, std::memory_order_relaxed);
+            producer->dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        case Overload_policy::Drop_oldest:
+            if (!drop_oldest(*producer)) wait_for_room(*producer);
+            break;
+        case Overload_policy::Spill:
+            return &producer->overflow;
+        }
+    }
+    return record;
+}
+
+/**
+ * @brief               Discard the oldest record of the calling thread's ring, unless it is a control message.
+ * @return              False if nothing could be dropped - the daemon is draining the ring, or the oldest
+ *                      record must not be lost.
+ *
+ * The owner becomes the consumer for one pop; producer.consuming keeps the daemon out meanwhile.
+ */
+bool Logger_async::drop_oldest(Producer& producer) {
+    if (producer.consuming.exchange(true, std::memory_order_acquire)) return false;
+
+    bool dropped = false;
+    Record* oldest = producer.ring.front();
+    if (oldest && (oldest->format || (oldest->message != Thread_REMOVE && oldest->message != Lg_STOP))) {
+        producer.report_to.store(oldest->thread_id, std::memory_order_relaxed);
+        producer.ring.pop_front();
+        producer.dropped.fetch_add(1, std::memory_order_relaxed);
+        dropped = true;
+    }
+    producer.consuming.store(false, std::memory_order_release);
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (producer.waiting_ring.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(producer.wait_mutex);
+        producer.wait_condition.notify_all();
+    }
+    return dropped;
+}
+
+/**
+ * @brief               Owner side - wait until the daemon has freed a slot of the ring.
+ *
+ * The flag is raised before the ring is checked again under wait_mutex, and the daemon checks the
+ * flag after releasing the slots it consumed, so one of the two always sees the other.
+ */
+void Logger_async::wait_for_room(Producer& producer) {
+    for (int i = 0; i < Wait_spins; i++) {
+        if (producer.ring.size() < producer.ring.capacity()) return;
+    }
+
+    std::unique_lock<std::mutex> lock(producer.wait_mutex);
+    producer.waiting_room.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    producer.wait_condition.wait(lock, [&producer] { return producer.ring.size() < producer.ring.capacity(); });
+    producer.waiting_room.store(false, std::memory_order_relaxed);
+}
+
+/**
+ * @brief               Wait until the lane of an output is back under the lane capacity.
+ */
+void Logger_async::wait_for_output(Output& output) {
+    std::unique_lock<std::mutex> lock(output.room_mutex_);
+    output.room_.wait(lock, [&output] { return !output.full_.load(std::memory_order_relaxed); });
+}
+
+/**
+ * @brief               Daemon side - become the consumer of a ring, waiting while its owner drops a record.
+ */
+void Logger_async::take_ring(Producer& producer) {
+    for (int i = 0; i < Wait_spins; i++) {
+        if (!producer.consuming.exchange(true, std::memory_order_acquire)) return;
+    }
+
+    std::unique_lock<std::mutex> lock(producer.wait_mutex);
+    producer.waiting_ring.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    producer.wait_condition.wait(lock, [&producer] { return !producer.consuming.exchange(true, std::memory_order_acquire); });
+    producer.waiting_ring.store(false, std::memory_order_relaxed);
+}
+
+/**
+ * @brief               Queue a plain text message.
+ * @return              False if the message was dropped.
+ *
+ * The text is copied into the string of the claimed slot rather than moved in, so the slot keeps
+ * the buffer it was recycled with and a message no longer than earlier ones allocates nothing.
+ */
+bool Logger_async::enqueue(std::thread::id thread_id, std::uint32_t slot, std::uint64_t tick, LogLevel level, bool has_level, const char* message, std::size_t length, Overload_policy policy) {
+    Record* record = claim_record(thread_id, slot, policy);
+    if (!record) return false;
+    record->level = level;
+    record->has_level = has_level;
+    record->thread_id = thread_id;
+    record->slot = slot;
+    record->tick = tick;
+    record->format = nullptr;
+    record->args_size = 0;
+    record->message.assign(message, length);
+    publish_record(*record);
+    return true;
+}
+
+/**
+ * @brief               Make the claimed record visible to the daemon and wake it if it sleeps.
+ * @param record        The record returned by claim_record().
+ *
+ * The only shared state touched on this path is the daemon's sleep flag; the wake mutex is taken
+ * only when the daemon is actually parked on the condition variable.
+ */
+void Logger_async::publish_record(Record& record) {
+    Producer* producer = local_producer();
+    if (&record == &producer->overflow) {
+        spill_record(*producer, record);
+        return;
+    }
+    producer->ring.publish();
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (daemon_sleeping_.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        condition_.notify_one();
+    }
+}
+
+/**
+ * @brief               Write a record that did not fit in the ring to the spill file, on the calling thread.
+ *
+ * The line has the same layout as File_Log lines. Spilled lines are flushed at once, as the
+ * daemon never sees them.
+ */
+void Logger_async::spill_record(Producer& producer, const Record& record) {
+    std::lock_guard<std::mutex> lock(spill_mutex_);
+    if (!spill_file_) return;
+
+    const std::string* message = &record.message;
+    if (record.format) {
+        spill_text_.clear();
+        Logger_args::render(record.format, record_args(record), record.args_size, spill_text_);
+        message = &spill_text_;
+    }
+
+    char time_text[Logger_time_formatter::Max_length];
+    std::size_t time_length = spill_formatter_.format(record.tick, time_text);
+    spill_line_.clear();
+    // The calling thread's hazard still pins the table its slot came from.
+    const Routing_table* routes = producer.hazard.load(std::memory_order_relaxed);
+    std::string id_text;
+    const std::string* thread_text = &id_text;
+    if (record.slot < routes->routes.size() && routes->routes[record.slot].thread_id == record.thread_id)
+        thread_text = routes->routes[record.slot].text.get();
+    else
+        id_text = convert_to_str(record.thread_id);
+    append_line(spill_line_, time_text, time_length, *thread_text, record.level, record.has_level, *message);
+    spill_line_.push_back('\n');
+    spill_file_->append(spill_line_);
+    spill_file_->flush();
+
+    producer.report_to.store(record.thread_id, std::memory_order_relaxed);
+    producer.spilled.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief          Convert all data type to string.
+ * @param data     Data needs to be converted.
+ */
+template <typename T> std::string Logger_async::convert_to_str(T data) {
+    std::stringstream strm;
+    strm << data;
+    return strm.str();
+}
+
+/**
+ * @brief  Take over the whole backlog of every producer ring and queue it to the outputs' lanes.
+ * @param  report  Log the overload counts first.
+ * @return Number of records handled.
+ */
+std::size_t Logger_async::drain_producers(bool report) {
+    std::size_t version = producers_version_.load(std::memory_order_acquire);
+    if (version != drain_version_) {
+        std::lock_guard<std::mutex> lock(producers_mutex_);
+        drain_list_ = producers_;
+        drain_version_ = version;
+    }
+    if (report) report_overload();
+
+    // One clock reading per pass; records published after it count as taken at once.
+    std::uint64_t now = Logger_clock::now();
+    std::size_t handled = 0;
+    for (auto& producer : drain_list_) {
+        take_ring(*producer);
+        draining_ = producer.get();
+        drained_ = 0;
+        std::size_t consumed = producer->ring.consume_all([this, now](Record& record) {
+            std::atomic<std::uint64_t>& bucket = queue_latency_[latency_bucket(now > record.tick ? now - record.tick : 0)];
+            bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            handle_record(record);
+            drained_++;
+        });
+        draining_ = nullptr;
+        producer->consuming.store(false, std::memory_order_release);
+        handled += consumed;
+
+        // The owner may be asleep in wait_for_room() - see there.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (consumed != 0 && producer->waiting_room.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(producer->wait_mutex);
+            producer->wait_condition.notify_all();
+        }
+    }
+    handled_.store(handled_.load(std::memory_order_relaxed) + handled, std::memory_order_relaxed);
+    if (handled > max_queue_depth_.load(std::memory_order_relaxed))
+        max_queue_depth_.store(handled, std::memory_order_relaxed);
+    apply_removals();
+    dispatch_batch();
+    return handled;
+}
+
+/**
+ * @brief  Apply, in the order they were asked for, the removals whose rings have been consumed up to their marks.
+ *
+ * A removal is staged as a "Thread_RM" record of the removed thread, so it follows every message
+ * staged for the thread before it and takes the thread's routes away as before.
+ */
+void Logger_async::apply_removals() {
+    if (removals_pending_.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(removals_mutex_);
+        for (Removal& removal : removals_)
+            waiting_removals_.push_back(std::move(removal));
+        removals_.clear();
+        removals_pending_.store(false, std::memory_order_relaxed);
+    }
+
+    std::size_t applied = 0;
+    for (; applied < waiting_removals_.size(); applied++) {
+        Removal& removal = waiting_removals_[applied];
+        bool reached = true;
+        for (const auto& mark : removal.marks)
+            reached = reached && mark.first->ring.consumed() >= mark.second;
+        if (!reached) break;
+
+        Record record;
+        record.thread_id = removal.thread_id;
+        record.slot = daemon_slot(removal.thread_id);
+        record.tick = removal.tick;
+        record.format = nullptr;
+        record.args_size = 0;
+        record.level = LogLevel::INFO;
+        record.has_level = false;
+        record.message = Thread_REMOVE;
+        handle_record(record);
+    }
+    waiting_removals_.erase(waiting_removals_.begin(), waiting_removals_.begin() + applied);
+}
+
+/**
+ * @brief  Fill in a WARNING-style report record of the logger, with its arguments encoded.
+ */
+template <typename... Args>
+void Logger_async::fill_report(Record& report, std::thread::id thread_id, LogLevel level, bool has_level, const char* format, const Args&... args) {
+    report.thread_id = thread_id;
+    report.slot = daemon_slot(thread_id);
+    report.tick = Logger_clock::now();
+    report.format = format;
+    report.level = level;
+    report.has_level = has_level;
+    std::size_t size = Logger_args::size_of(args...);
+    report.args_size = static_cast<std::uint32_t>(size);
+    if (size <= Inline_args) {
+        Logger_args::encode(report.args, args...);
+    }
+    else {
+        report.message.resize(size);
+        Logger_args::encode(reinterpret_cast<unsigned char*>(&report.message[0]), args...);
+    }
+}
+
+/**
+ * @brief  Check whether any producer has lost or spilled records, any call site of this logger has
+ *         suppressed calls, or any thread has repeated messages, that are not reported yet.
+ */
+bool Logger_async::overload_pending() {
+    if (repeats_pending_ != 0) return true;
+    for (auto& producer : drain_list_) {
+        if (producer->dropped.load(std::memory_order_relaxed) != 0 || producer->spilled.load(std::memory_order_relaxed) != 0)
+            return true;
+    }
+    for (Logger_limit* limit = Logger_limit::first(); limit; limit = limit->next()) {
+        if (limit->pending(this)) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief  Log how many records each producer dropped or spilled, and how many calls each rate-limited
+ *         call site suppressed, since the last report, and end the runs of repeated messages.
+ *
+ * A report is an ordinary message in the outputs of the thread whose records were lost last, or
+ * whose call was suppressed first.
+ */
+void Logger_async::report_overload() {
+    last_report_ = std::chrono::steady_clock::now();
+    for (auto& producer : drain_list_) {
+        std::uint64_t dropped = producer->dropped.exchange(0, std::memory_order_relaxed);
+        std::uint64_t spilled = producer->spilled.exchange(0, std::memory_order_relaxed);
+        if (dropped == 0 && spilled == 0) continue;
+        dropped_total_.store(dropped_total_.load(std::memory_order_relaxed) + dropped, std::memory_order_relaxed);
+        spilled_total_.store(spilled_total_.load(std::memory_order_relaxed) + spilled, std::memory_order_relaxed);
+
+        Record report;
+        fill_report(report, producer->report_to.load(std::memory_order_relaxed), LogLevel::WARNING, true, Overload_format, dropped, spilled);
+        handle_record(report);
+    }
+
+    for (Logger_limit* limit = Logger_limit::first(); limit; limit = limit->next()) {
+        std::thread::id report_to;
+        std::uint64_t suppressed = limit->take_suppressed(this, report_to);
+        if (suppressed == 0) continue;
+        suppressed_total_.store(suppressed_total_.load(std::memory_order_relaxed) + suppressed, std::memory_order_relaxed);
+
+        Record report;
+        fill_report(report, report_to, LogLevel::WARNING, true, Limit_format, suppressed, limit->site());
+        handle_record(report);
+    }
+
+    end_repeats();
+}
+
+/**
+ * @brief  Take one record from a ring - count it if it repeats the thread's last message, stage it otherwise.
+ */
+void Logger_async::handle_record(Record& record) {
+    if (compaction_.load(std::memory_order_relaxed)) {
+        if (compact_record(record)) return;
+    }
+    else if (!repeats_.empty()) {
+        end_repeats();
+        repeats_.clear();
+    }
+    stage_record(record);
+}
+
+/**
+ * @brief  Hash of a message's format and text or encoded arguments (64-bit FNV-1a).
+ */
+std::uint64_t Logger_async::repeat_hash(const char* format, const unsigned char* data, std::size_t size) {
+    std::uint64_t hash = 14695981039346656037ULL ^ reinterpret_cast<std::uintptr_t>(format);
+    for (std::size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief  Count a record that repeats the last message of its thread instead of staging it.
+ * @return True if the record was counted; otherwise the run of the last message is ended and the
+ *         record becomes the message later ones are compared with.
+ *
+ * Messages are compared by hash first, then byte for byte when the hashes match.
+ */
+bool Logger_async::compact_record(Record& record) {
+    if (!record.format && (record.message == Lg_START || record.message == Lg_STOP || record.message == Thread_REMOVE)) {
+        auto search = repeats_.find(record.thread_id);
+        if (search != repeats_.end() && record.message == Thread_REMOVE) {
+            end_repeat(search->first, search->second);
+            repeats_.erase(search);
+        }
+        return false;
+    }
+
+    const unsigned char* data = record.format ? record_args(record) : reinterpret_cast<const unsigned char*>(record.message.data());
+    std::size_t size = record.format ? record.args_size : record.message.size();
+    std::uint64_t hash = repeat_hash(record.format, data, size);
+
+    Repeat& repeat = repeats_[record.thread_id];
+    if (repeat.valid && repeat.hash == hash && repeat.format == record.format && repeat.level == record.level
+        && repeat.has_level == record.has_level && repeat.bytes.size() == size && std::memcmp(repeat.bytes.data(), data, size) == 0) {
+        if (repeat.count++ == 0) {
+            repeat.first_tick = record.tick;
+            repeats_pending_++;
+        }
+        repeat.last_tick = record.tick;
+        folded_.store(folded_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    end_repeat(record.thread_id, repeat);
+    repeat.valid = true;
+    repeat.hash = hash;
+    repeat.format = record.format;
+    repeat.level = record.level;
+    repeat.has_level = record.has_level;
+    repeat.bytes.assign(reinterpret_cast<const char*>(data), size);
+    return false;
+}
+
+/**
+ * @brief  Write the count of a run of repeated messages, if there is one, stamped with its last copy.
+ */
+void Logger_async::end_repeat(std::thread::id thread_id, Repeat& repeat) {
+    if (repeat.count == 0) return;
+
+    char first[Logger_time_formatter::Max_length + 1];
+    char last[Logger_time_formatter::Max_length + 1];
+    first[time_formatter_.format(repeat.first_tick, first)] = '\0';
+    last[time_formatter_.format(repeat.last_tick, last)] = '\0';
+
+    Record summary;
+    fill_report(summary, thread_id, repeat.level, repeat.has_level, Repeat_format, repeat.count, static_cast<const char*>(first), static_cast<const char*>(last));
+    summary.tick = repeat.last_tick;
+    repeat.count = 0;
+    repeats_pending_--;
+    stage_record(summary);
+}
+
+/**
+ * @brief  Write the counts of every thread's run of repeated messages.
+ */
+void Logger_async::end_repeats() {
+    if (repeats_pending_ == 0) return;
+    for (auto& repeat : repeats_)
+        end_repeat(repeat.first, repeat.second);
+}
+
+/**
+ * @brief  Move one record into the current batch and stage it for the lanes of its thread's outputs.
+ *
+ * The ring slot gets the buffers of a recycled batch item in exchange, so neither side allocates
+ * once the strings have grown.
+ */
+void Logger_async::stage_record(Record& record) {
+    std::thread::id thread_id = record.thread_id;
+    bool stop = !record.format && record.message == Lg_STOP;
+    bool remove = !record.format && record.message == Thread_REMOVE;
+
+    if (routes_.load(std::memory_order_acquire) != daemon_routes_)
+        daemon_routes_ = acquire_routes(daemon_hazard_);
+
+    const Route* route = record.slot < daemon_routes_->routes.size() ? &daemon_routes_->routes[record.slot] : nullptr;
+    if (route && route->thread_id == thread_id && !route->outputs.empty()) {
+        std::uint32_t index = static_cast<std::uint32_t>(batch_ ? batch_->size : 0);
+        Batch_item& item = next_item();
+        std::swap(item.record, record);
+        item.wall_ns = time_formatter_.to_wall_ns(item.record.tick);
+        item.thread_text = route->text;
+        item.has_line = false;
+
+        bool needs_line = false;
+        for (const std::shared_ptr<Output>& output : route->outputs) {
+            needs_line = needs_line || output->needs_line();
+            Lane* lane = lane_for(output);
+            if (lane->staging.empty()) touched_lanes_.push_back(lane);
+            lane->staging.push_back(index);
+        }
+        if (needs_line) format_item(item);
+        item.unwritten.store(static_cast<std::uint32_t>(route->outputs.size()), std::memory_order_release);
+        batch_->published.store(batch_->size, std::memory_order_release);
+
+        if (remove)
+        {
+            // Losses not reported yet would otherwise have nowhere to go.
+            if (overload_pending()) report_overload();
+            update_routes(thread_id, nullptr);
+            lanes_stale_ = true;
+        }
+    }
+
+    if (stop)
+    {
+        stop_daemon=true;
+    }
+}
+
+/**
+ * @brief  Encoded arguments of a formatted record - inline, or in the bytes of its message.
+ */
+const unsigned char* Logger_async::record_args(const Record& record) {
+    return record.args_size <= Inline_args ? record.args : reinterpret_cast<const unsigned char*>(record.message.data());
+}
+
+/**
+ * @brief  Next free item of the current batch, starting a batch if there is none.
+ *
+ * New items reserve room for a typical line; their record string, like the ring slots', gets
+ * Record_reserve bytes. Items and slots trade record strings, so every buffer in circulation has
+ * room for a typical message, and one only grows for a longer message than it has held before.
+ */
+Logger_async::Batch_item& Logger_async::next_item() {
+    if (!batch_) batch_ = new_batch();
+    if (batch_->size == batch_->items.size()) {
+        // Growing moves the items; crash_flush() waits for it, or the daemon stops if it has started.
+        bool moves = batch_->items.size() == batch_->items.capacity();
+        if (moves) {
+            batch_->growing.store(true, std::memory_order_seq_cst);
+            if (crashing_.load(std::memory_order_seq_cst)) {
+                batch_->growing.store(false, std::memory_order_release);
+                crash_park_daemon();
+            }
+        }
+        batch_->items.emplace_back();
+        if (moves) batch_->growing.store(false, std::memory_order_release);
+        Batch_item& item = batch_->items.back();
+        item.record.message.reserve(Record_reserve);
+        item.message.reserve(Item_reserve);
+        item.line.reserve(Item_reserve);
+    }
+    return batch_->items[batch_->size++];
+}
+
+/**
+ * @brief  Render the message and the "[time] - [thread]\t- message" line of an item.
+ */
+void Logger_async::format_item(Batch_item& item) {
+    const std::string* message = &item.record.message;
+    if (item.record.format) {
+        item.message.clear();
+        Logger_args::render(item.record.format, record_args(item.record), item.record.args_size, item.message);
+        message = &item.message;
+    }
+
+    char time_text[Logger_time_formatter::Max_length];
+    std::size_t time_length = time_formatter_.format_wall(item.wall_ns, time_text);
+    item.line.clear();
+    append_line(item.line, time_text, time_length, *item.thread_text, item.record.level, item.record.has_level, *message);
+    item.has_line = true;
+}
+
+/**
+ * @brief  Append a "[time] - [thread]\t- message" log line; messages logged with a level get "[LEVEL] " before the text.
+ */
+void Logger_async::append_line(std::string& line, const char* time_text, std::size_t time_length, const std::string& thread_text,
+                               LogLevel level, bool has_level, const std::string& message) {
+    line.append("[").append(time_text, time_length).append("] - [").append(thread_text).append("]\t- ");
+    if (has_level) line.append("[").append(Logger_binary::Level_names[static_cast<int>(level)]).append("] ");
+    line.append(message);
+}
+
+/**
+ * @brief  An empty batch from the pool; it returns to the pool when the last lane releases it.
+ */
+Logger_async::Batch* Logger_async::new_batch() {
+    Batch* batch = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(batch_pool_mutex_);
+        if (!batch_pool_.empty()) {
+            batch = batch_pool_.back();
+            batch_pool_.pop_back();
+        }
+    }
+    if (!batch) {
+        batch = new Batch();
+        for (auto& slot : crash_batches_) {
+            if (slot.load(std::memory_order_relaxed)) continue;
+            slot.store(batch, std::memory_order_release);
+            break;
+        }
+    }
+    batch->size = 0;
+    batch->published.store(0, std::memory_order_release);
+    return batch;
+}
+
+/**
+ * @brief  Let go of a batch; the last holder puts it back in the pool.
+ */
+void Logger_async::release_batch(Batch* batch) {
+    if (batch->holders.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+    std::lock_guard<std::mutex> lock(batch_pool_mutex_);
+    batch_pool_.push_back(batch);
+}
+
+/**
+ * @brief  The lane of an output, starting one - or taking back one that is shutting down - if needed.
+ */
+Logger_async::Lane* Logger_async::lane_for(const std::shared_ptr<Output>& output) {
+    auto search = lanes_.find(output.get());
+    if (search != lanes_.end()) return search->second.get();
+
+    std::unique_ptr<Lane> lane;
+    for (auto it = closing_lanes_.begin(); it != closing_lanes_.end(); ++it) {
+        if ((*it)->output() != output.get()) continue;
+        if ((*it)->reopen()) lane = std::move(*it);
+        else if (!crash_remove_lane(it->get())) it->release();
+        closing_lanes_.erase(it);
+        break;
+    }
+    if (!lane) {
+        lane.reset(new Lane(*this, output));
+        crash_add_lane(lane.get());
+    }
+
+    Lane* result = lane.get();
+    lanes_[output.get()] = std::move(lane);
+    return result;
+}
+
+/**
+ * @brief  Hand the current batch to every lane that has items staged in it.
+ */
+void Logger_async::dispatch_batch() {
+    if (batch_ && batch_->size != 0) {
+        // The daemon holds the batch too until every lane has it, so an early finisher cannot recycle it.
+        batch_->holders.store(touched_lanes_.size() + 1, std::memory_order_relaxed);
+        for (Lane* lane : touched_lanes_) {
+            if (!lane->submit(batch_)) release_batch(batch_);
+        }
+        release_batch(batch_);
+        batch_ = nullptr;
+    }
+    touched_lanes_.clear();
+    if (lanes_stale_) retire_lanes();
+}
+
+/**
+ * @brief  Close the lanes of outputs no thread is routed to any more, and join lanes that have finished.
+ *
+ * A closing lane still writes and flushes what was queued to it before its thread ends.
+ */
+void Logger_async::retire_lanes() {
+    lanes_stale_ = false;
+    if (routes_.load(std::memory_order_acquire) != daemon_routes_)
+        daemon_routes_ = acquire_routes(daemon_hazard_);
+
+    std::vector<const Output*> live;
+    for (const Route& route : daemon_routes_->routes) {
+        for (const std::shared_ptr<Output>& output : route.outputs)
+            live.push_back(output.get());
+    }
+
+    for (auto it = lanes_.begin(); it != lanes_.end();) {
+        if (std::find(live.begin(), live.end(), it->first) != live.end()) {
+            ++it;
+            continue;
+        }
+        it->second->close();
+        closing_lanes_.push_back(std::move(it->second));
+        it = lanes_.erase(it);
+    }
+
+    for (auto it = closing_lanes_.begin(); it != closing_lanes_.end();) {
+        if (!(*it)->finished()) {
+            ++it;
+            continue;
+        }
+        if (!crash_remove_lane(it->get())) it->release();
+        it = closing_lanes_.erase(it);
+    }
+}
+
+/**
+ * @brief  Queue a flush request for the daemon and wake it.
+ *
+ * Everything published before the request was queued is visible to the daemon's next drain, which
+ * is the one that issues the barrier.
+ */
+std::future<void> Logger_async::request_flush(std::thread::id thread_id, bool all_outputs) {
+    Flush_request request;
+    request.barrier = std::make_shared<Flush_barrier>();
+    request.thread_id = thread_id;
+    request.all_outputs = all_outputs;
+    std::future<void> done = request.barrier->done.get_future();
+    {
+        std::lock_guard<std::mutex> lock(flush_mutex_);
+        flush_requests_.push_back(std::move(request));
+        flush_pending_.store(true, std::memory_order_release);
+    }
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (daemon_sleeping_.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        condition_.notify_one();
+    }
+    return done;
+}
+
+/**
+ * @brief  Queue a barrier behind the batches already given to the lanes each request waits for.
+ *
+ * A lane reaching the barrier flushes its output and arrives; the request completes when the
+ * daemon and all of its lanes have arrived.
+ */
+void Logger_async::issue_barriers(std::vector<Flush_request>& requests) {
+    if (routes_.load(std::memory_order_acquire) != daemon_routes_)
+        daemon_routes_ = acquire_routes(daemon_hazard_);
+
+    std::vector<Lane*> targets;
+    for (Flush_request& request : requests) {
+        targets.clear();
+        if (request.all_outputs) {
+            for (auto& lane : lanes_) targets.push_back(lane.second.get());
+            for (auto& lane : closing_lanes_) targets.push_back(lane.get());
+        }
+        else {
+            auto search = daemon_routes_->slots.find(request.thread_id);
+            if (search != daemon_routes_->slots.end()) {
+                for (const std::shared_ptr<Output>& output : daemon_routes_->routes[search->second].outputs) {
+                    auto lane = lanes_.find(output.get());
+                    if (lane != lanes_.end()) targets.push_back(lane->second.get());
+                }
+            }
+        }
+
+        Flush_barrier& barrier = *request.barrier;
+        barrier.waiting.store(targets.size() + 1, std::memory_order_relaxed);
+        for (Lane* lane : targets) {
+            if (!lane->submit_barrier(request.barrier)) barrier.arrive();
+        }
+        barrier.arrive();
+    }
+    requests.clear();
+}
+
+/**
+ * @brief  Latency bucket of a wait - 0 under 1 us, i for 2^(i-1) to 2^i us, the last one for anything longer.
+ */
+std::size_t Logger_async::latency_bucket(std::uint64_t nanoseconds) {
+    std::uint64_t micros = nanoseconds / 1000;
+    std::size_t bucket = 0;
+    while (micros != 0 && bucket < Latency_buckets - 1) {
+        micros >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/**
+ * @brief  Time the next stats report is due; only meaningful while reports are on.
+ */
+std::chrono::steady_clock::time_point Logger_async::stats_deadline() const {
+    return last_stats_ + std::chrono::milliseconds(stats_interval_.load(std::memory_order_relaxed));
+}
+
+/**
+ * @brief  Log the logger's counters to the outputs of the thread chosen with set_stats_report().
+ *
+ * The lines go out with the batch the daemon is building, like the overload reports.
+ */
+void Logger_async::report_stats() {
+    last_stats_ = std::chrono::steady_clock::now();
+    Stats current = stats();
+    std::thread::id thread_id = stats_to_.load(std::memory_order_relaxed);
+
+    Record report;
+    fill_report(report, thread_id, LogLevel::INFO, true, Stats_format, current.enqueued, current.dropped, current.spilled, current.suppressed,
+                current.queue_depth, current.max_queue_depth, Stats::percentile(current.queue_latency, 0.5),
+                Stats::percentile(current.queue_latency, 0.99), Stats::percentile(current.write_latency, 0.99));
+    stage_record(report);
+
+    for (std::size_t i = 0; i < current.outputs.size(); i++) {
+        const Output::Stats& output = current.outputs[i].second;
+        Record line;
+        fill_report(line, thread_id, LogLevel::INFO, true, Output_stats_format, i, output.written, output.bytes, output.write_ns / 1000,
+                    output.dropped, output.backlog, output.max_backlog);
+        stage_record(line);
+    }
+}
+
+/**
+ * @brief  Daemon thread for outputting log messages.
+ *
+ * Sleeps on condition_ only after announcing it through daemon_sleeping_ and re-checking every ring
+ * under wake_mutex_, so a producer that pushed in between always sees the flag and wakes it. While
+ * drops, spills or suppressed calls are unreported, or stats reports are on, the sleep is bounded by
+ * the next report.
+ */
+void Logger_async::daemon_thread() {
+    last_report_ = std::chrono::steady_clock::now();
+    last_stats_ = last_report_ - std::chrono::hours(1);
+    const std::chrono::seconds report_interval(1);
+
+    std::vector<Flush_request> flushes;
+    while (!stop_daemon) {
+        bool report = std::chrono::steady_clock::now() - last_report_ >= report_interval && overload_pending();
+        if (stats_interval_.load(std::memory_order_acquire) > 0 && std::chrono::steady_clock::now() >= stats_deadline())
+            report_stats();
+        if (flush_pending_.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(flush_mutex_);
+            flushes.swap(flush_requests_);
+            flush_pending_.store(false, std::memory_order_relaxed);
+        }
+        std::size_t handled = drain_producers(report);
+        if (!flushes.empty()) {
+            if (repeats_pending_ != 0) {
+                end_repeats();
+                dispatch_batch();
+            }
+            issue_barriers(flushes);
+            continue;
+        }
+        if (handled != 0) continue;
+
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        daemon_sleeping_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool pending = flush_pending_.load(std::memory_order_relaxed) || removals_pending_.load(std::memory_order_relaxed);
+        if (!pending) {
+            std::lock_guard<std::mutex> producers_lock(producers_mutex_);
+            for (auto& producer : producers_) {
+                if (!producer->ring.empty()) { pending = true; break; }
+            }
+        }
+        if (!pending && stats_interval_.load(std::memory_order_relaxed) > 0) {
+            std::chrono::steady_clock::time_point deadline = stats_deadline();
+            if (overload_pending() && last_report_ + report_interval < deadline) deadline = last_report_ + report_interval;
+            condition_.wait_until(lock, deadline);
+        }
+        else if (!pending) {
+            if (overload_pending()) condition_.wait_until(lock, last_report_ + report_interval);
+            else                    condition_.wait(lock);
+        }
+        daemon_sleeping_.store(false, std::memory_order_relaxed);
+    }
+
+    // Lg_STOP only ends the loop; messages other threads queued before it still go out.
+    drain_producers(overload_pending());
+    end_repeats();
+    dispatch_batch();
+    lanes_.clear();
+    closing_lanes_.clear();
+
+    // The lanes have written everything, so flushes asked for meanwhile are complete.
+    {
+        std::lock_guard<std::mutex> lock(flush_mutex_);
+        flushes.swap(flush_requests_);
+    }
+    issue_barriers(flushes);
+}
+
+/**
+ * @brief  Function registered with Logger_crash by enable_crash_flush().
+ */
+void Logger_async::crash_handler(void* context, int signal) {
+    static_cast<Logger_async*>(context)->crash_flush(signal);
+}
+
+/**
+ * @brief  Stop the calling thread for good - crash_flush() is reading what it would change, and the
+ *         process ends once the handler returns.
+ */
+void Logger_async::crash_park() {
+    while (true)
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+}
+
+/**
+ * @brief  Stop the daemon for crash_flush(), telling it how far the daemon got in the ring it holds.
+ *
+ * crash_flush() cannot take that ring over, so it writes the records the daemon had not handled yet
+ * straight from it. Records are counted once handled, so one that staged a report after itself may
+ * be written twice, but none is skipped.
+ */
+void Logger_async::crash_park_daemon() {
+    parked_drained_.store(drained_, std::memory_order_relaxed);
+    parked_ring_.store(draining_, std::memory_order_release);
+    crash_park();
+}
+
+/**
+ * @brief  Let crash_flush() reach a new lane. Daemon only.
+ */
+void Logger_async::crash_add_lane(Lane* lane) {
+    for (auto& slot : crash_lanes_) {
+        if (slot.load(std::memory_order_relaxed)) continue;
+        slot.store(lane, std::memory_order_seq_cst);
+        return;
+    }
+}
+
+/**
+ * @brief  Take a lane out of crash_flush()'s reach before it is freed. Daemon only.
+ * @return False if crash_flush() has started and may be using the lane; it must not be freed then.
+ */
+bool Logger_async::crash_remove_lane(Lane* lane) {
+    for (auto& slot : crash_lanes_) {
+        if (slot.load(std::memory_order_relaxed) != lane) continue;
+        slot.store(nullptr, std::memory_order_seq_cst);
+        break;
+    }
+    return !crashing_.load(std::memory_order_seq_cst);
+}
+
+/**
+ * @brief  Write out everything the logger holds, from a fatal signal handler or std::terminate.
+ * @param  signal  The signal, or 0 for std::terminate.
+ *
+ * Only async-signal-safe calls are made, nothing is allocated and no lock is taken. The handler
+ * reads only what the other threads publish for it: the fixed arrays of rings, batches and lanes,
+ * each batch's published count and each item's unwritten count. It first raises crashing_; from then
+ * on the daemon stops rather than move a batch's items or free a lane, and every lane stops before
+ * its next call into its output. Then it
+ *  1. becomes the consumer of every ring, so neither the daemon nor the owner can take records out -
+ *     or, for the ring the daemon holds if it stopped while moving records out, notes how far it got;
+ *  2. waits for each lane to leave its output, and has the output write what it has buffered;
+ *  3. appends every batch item some lane has not written or dropped to the crash file;
+ *  4. appends the records still queued in the rings to the crash file.
+ * All waiting together is bounded by Crash_naps.
+ *
+ * What can still be lost:
+ *  - the queued records of a ring that the daemon, or its owner dropping its oldest record, neither
+ *    let go of in time nor stopped in - e.g. the crash happened on that thread;
+ *  - what an output has buffered if its lane did not leave it in time - e.g. the crash happened
+ *    inside the output; the message it was writing may also reach the crash file, or be cut short;
+ *  - a report, removal or repeat count the daemon was staging at that moment, and the counts of
+ *    repeated messages folded but not written yet;
+ *  - rings, batches and lanes beyond the first Crash_slots of each;
+ *  - lines of a rotated file segment the rotation thread has not flushed yet (see File_Log::rotate());
+ *  - messages whose add_log() had not returned.
+ * Lines in the crash file come batch by batch, then ring by ring, so they are not sorted by time.
+ */
+void Logger_async::crash_flush(int signal) {
+    crash_signal_ = signal;
+    crashing_.store(true, std::memory_order_seq_cst);
+    int naps = Crash_naps;
+    Logger_crash::Writer writer;
+
+    bool held[Crash_slots];
+    std::size_t handled[Crash_slots];      // Queued records of a held ring that are in a batch already.
+    for (std::size_t i = 0; i < Crash_slots; i++) {
+        Producer* producer = crash_producers_[i].load(std::memory_order_acquire);
+        held[i] = producer && !producer->consuming.exchange(true, std::memory_order_acquire);
+        handled[i] = 0;
+        while (producer && !held[i]) {
+            if (parked_ring_.load(std::memory_order_acquire) == producer) {
+                held[i] = true;
+                handled[i] = parked_drained_.load(std::memory_order_relaxed);
+                break;
+            }
+            if (naps <= 0) break;
+            naps--;
+            Logger_crash::nap();
+            held[i] = !producer->consuming.exchange(true, std::memory_order_acquire);
+        }
+    }
+
+    for (auto& slot : crash_lanes_) {
+        Lane* lane = slot.load(std::memory_order_seq_cst);
+        if (lane) lane->crash_flush(naps);
+    }
+
+    for (auto& slot : crash_batches_) {
+        Batch* batch = slot.load(std::memory_order_acquire);
+        if (!batch) continue;
+        while (batch->growing.load(std::memory_order_seq_cst) && naps > 0) {
+            naps--;
+            Logger_crash::nap();
+        }
+        if (batch->growing.load(std::memory_order_seq_cst)) continue;
+
+        std::size_t published = batch->published.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < published; i++) {
+            const Batch_item& item = batch->items[i];
+            if (item.unwritten.load(std::memory_order_acquire) == 0) continue;
+            crash_record(writer, item.record, item.wall_ns, item.thread_text.get(),
+                         item.has_line && item.record.format ? &item.message : nullptr);
+        }
+    }
+
+    const Routing_table* routes = acquire_routes(crash_hazard_);
+    for (std::size_t i = 0; i < Crash_slots; i++) {
+        if (!held[i]) continue;
+        std::size_t skip = handled[i];
+        crash_producers_[i].load(std::memory_order_relaxed)->ring.for_each_queued([&](const Record& record) {
+            if (skip > 0) {
+                skip--;
+                return;
+            }
+            const std::string* text = nullptr;
+            if (record.slot < routes->routes.size() && routes->routes[record.slot].thread_id == record.thread_id)
+                text = routes->routes[record.slot].text.get();
+            crash_record(writer, record, crash_formatter_.to_wall_ns(record.tick), text, nullptr);
+        });
+    }
+}
+
+/**
+ * @brief  Write a record as a "[UTC time] - [thread]\t- [LEVEL] message" line to the crash file,
+ *         opening it and writing a line about the crash first if this is the first record.
+ * @param  thread_text  Id or name of the thread, or nullptr if it is not known.
+ * @param  message      Rendered text of a formatted record, or nullptr to render it here.
+ *
+ * A formatted record is rendered into crash_message_ only if the text is sure to fit in its
+ * reserved capacity - no argument renders to more than three characters per encoded byte. A longer
+ * one is written as its bare format. Numbers with a fraction go through Logger_args::format_double()
+ * rather than snprintf(), which POSIX does not list as async-signal-safe.
+ */
+void Logger_async::crash_record(Logger_crash::Writer& writer, const Record& record, std::int64_t wall_ns,
+                                const std::string* thread_text, const std::string* message) {
+    char time_text[Logger_time_formatter::Max_length];
+    if (!writer.is_open()) {
+        if (!writer.open(crash_path_.c_str())) return;
+        writer.append("[");
+        writer.append(time_text, Logger_time_formatter::format_utc(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count(), time_text));
+        writer.append("] - [Logger]\t- Logger crash (");
+        if (crash_signal_ != 0) {
+            writer.append("signal ");
+            writer.append_uint(static_cast<std::uint64_t>(crash_signal_));
+        }
+        else {
+            writer.append("std::terminate");
+        }
+        writer.append("), messages not written to the outputs follow\n");
+    }
+
+    writer.append("[");
+    writer.append(time_text, Logger_time_formatter::format_utc(wall_ns, time_text));
+    writer.append("] - [");
+    if (thread_text) writer.append(*thread_text);
+    writer.append("]\t- ");
+    if (record.has_level) {
+        writer.append("[");
+        writer.append(Logger_binary::Level_names[static_cast<int>(record.level)]);
+        writer.append("] ");
+    }
+    if (!record.format) {
+        writer.append(record.message);
+    }
+    else if (message) {
+        writer.append(*message);
+    }
+    else if (std::strlen(record.format) + 3 * record.args_size <= crash_message_.capacity()) {
+        crash_message_.clear();
+        Logger_args::render(record.format, record_args(record), record.args_size, crash_message_, true, true);
+        writer.append(crash_message_);
+    }
+    else {
+        writer.append(record.format);
+    }
+    writer.append("\n", 1);
+}
@@ -0,0 +1,131 @@
+#include "../headers/Logger_ring.hh"
+
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+/**
+ * @brief Queue contention benchmark.
+ *
+ * Compares the mutex-guarded deque the async logger used to share between all producers with the
+ * per-producer rings it uses now. Producers push short strings as fast as they can while a single
+ * consumer drains them, which is the shape of Logger_async::add_log against daemon_thread.
+ */
+
+using Bench_clock = std::chrono::steady_clock;
+
+struct Bench_record {
+    std::thread::id thread_id;
+    std::string message;
+};
+
+/**
+ * @brief                   Every producer pushes into one deque under one mutex and notifies the consumer.
+ * @param num_threads       Number of producer threads.
+ * @param num_messages      Messages pushed by each producer.
+ * @return                  Elapsed seconds until the consumer has popped everything.
+ */
+double bench_mutex_deque(int num_threads, int num_messages) {
+    std::mutex mutexlock;
+    std::condition_variable condition;
+    std::deque<Bench_record> messages_queue;
+    const long long total = static_cast<long long>(num_threads) * num_messages;
+
+    Bench_clock::time_point start = Bench_clock::now();
+    std::thread consumer([&] {
+        long long popped = 0;
+        while (popped < total) {
+            std::unique_lock<std::mutex> lock(mutexlock);
+            condition.wait(lock, [&] { return !messages_queue.empty(); });
+            Bench_record record = std::move(messages_queue.front());
+            messages_queue.pop_front();
+            popped++;
+        }
+    });
+
+    std::vector<std::thread> producers;
+    for (int t = 0; t < num_threads; t++) {
+        producers.push_back(std::thread([&] {
+            for (int i = 0; i < num_messages; i++) {
+                std::lock_guard<std::mutex> lock(mutexlock);
+                messages_queue.push_back(Bench_record{std::this_thread::get_id(), "Message from producer"});
+                condition.notify_one();
+            }
+        }));
+    }
+    for (auto& producer : producers) producer.join();
+    consumer.join();
+
+    return std::chrono::duration<double>(Bench_clock::now() - start).count();
+}
+
+/**
+ * @brief                   Every producer owns a ring; the consumer round-robins over all of them.
+ * @param num_threads       Number of producer threads.
+ * @param num_messages      Messages pushed by each producer.
+ * @return                  Elapsed seconds until the consumer has popped everything.
+ */
+double bench_producer_rings(int num_threads, int num_messages) {
+    std::vector<std::unique_ptr<Logger_ring<Bench_record>>> rings;
+    for (int t = 0; t < num_threads; t++)
+        rings.push_back(std::unique_ptr<Logger_ring<Bench_record>>(new Logger_ring<Bench_record>(4096)));
+    const long long total = static_cast<long long>(num_threads) * num_messages;
+
+    Bench_clock::time_point start = Bench_clock::now();
+    std::thread consumer([&] {
+        long long popped = 0;
+        Bench_record record;
+        while (popped < total) {
+            bool idle = true;
+            for (auto& ring : rings) {
+                while (ring->try_pop(record)) {
+                    popped++;
+                    idle = false;
+                }
+            }
+            if (idle) std::this_thread::yield();
+        }
+    });
+
+    std::vector<std::thread> producers;
+    for (int t = 0; t < num_threads; t++) {
+        Logger_ring<Bench_record>* ring = rings[t].get();
+        producers.push_back(std::thread([ring, num_messages] {
+            for (int i = 0; i < num_messages; i++) {
+                Bench_record record{std::this_thread::get_id(), "Message from producer"};
+                while (!ring->try_push(std::move(record)))
+                    std::this_thread::yield();
+            }
+        }));
+    }
+    for (auto& producer : producers) producer.join();
+    consumer.join();
+
+    return std::chrono::duration<double>(Bench_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+    int num_messages = argc > 1 ? std::stoi(argv[1]) : 100000;
+    const int thread_counts[] = {1, 2, 4, 8, 16, 32, 64};
+
+    std::cout << "threads,queue,messages,seconds,messages_per_sec" << std::endl;
+    for (int num_threads : thread_counts) {
+        long long total = static_cast<long long>(num_threads) * num_messages;
+
+        double deque_time = bench_mutex_deque(num_threads, num_messages);
+        std::cout << num_threads << ",mutex_deque," << total << "," << deque_time << "," << static_cast<long long>(total / deque_time) << std::endl;
+
+        double ring_time = bench_producer_rings(num_threads, num_messages);
+        std::cout << num_threads << ",producer_rings," << total << "," << ring_time << "," << static_cast<long long>(total / ring_time) << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,252 @@
+#include "../headers/Logger_crash.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#define NOGDI
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+Logger_crash::Slot Logger_crash::slots_[Logger_crash::Max_handlers];
+std::atomic<bool> Logger_crash::ran_(false);
+std::mutex Logger_crash::mutex_;
+bool Logger_crash::installed_ = false;
+std::terminate_handler Logger_crash::previous_terminate_ = nullptr;
+
+namespace {
+#ifdef SIGBUS
+const int Crash_signals[] = { SIGSEGV, SIGABRT, SIGBUS, SIGFPE };
+#else
+const int Crash_signals[] = { SIGSEGV, SIGABRT, SIGFPE };
+#endif
+const std::size_t Signal_count = sizeof(Crash_signals) / sizeof(Crash_signals[0]);
+
+#ifdef _WIN32
+void (*previous_handlers[Signal_count])(int);
+#else
+struct sigaction previous_actions[Signal_count];
+#endif
+}
+
+/**
+* @brief            Set the handlers of the fatal signals and of std::terminate; later calls do nothing.
+* @return           False if a signal handler could not be set.
+*/
+bool Logger_crash::install() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (installed_) return true;
+
+    bool done = true;
+    for (std::size_t i = 0; i < Signal_count; i++) {
+#ifdef _WIN32
+        previous_handlers[i] = std::signal(Crash_signals[i], &Logger_crash::on_signal);
+        done = done && previous_handlers[i] != SIG_ERR;
+#else
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        action.sa_handler = &Logger_crash::on_signal;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_NODEFER;
+        done = sigaction(Crash_signals[i], &action, &previous_actions[i]) == 0 && done;
+#endif
+    }
+    previous_terminate_ = std::set_terminate(&Logger_crash::on_terminate);
+    installed_ = true;
+    return done;
+}
+
+/**
+* @brief            Register a function to run when the process crashes.
+* @param handler    Function to call; it must only use async-signal-safe calls.
+* @param context    Passed to handler.
+* @return           False if Max_handlers functions are registered already.
+*/
+bool Logger_crash::add(Handler handler, void* context) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (Slot& slot : slots_) {
+        if (slot.handler.load(std::memory_order_relaxed)) continue;
+        slot.context.store(context, std::memory_order_relaxed);
+        slot.handler.store(handler, std::memory_order_release);
+        return true;
+    }
+    return false;
+}
+
+/**
+* @brief            Unregister a function added with the same handler and context.
+*/
+void Logger_crash::remove(Handler handler, void* context) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (Slot& slot : slots_) {
+        if (slot.handler.load(std::memory_order_relaxed) != handler || slot.context.load(std::memory_order_relaxed) != context) continue;
+        slot.handler.store(nullptr, std::memory_order_release);
+        slot.context.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+/**
+* @brief            Run every registered function, the first time it is called.
+* @param signal     The fatal signal, or 0 for std::terminate.
+*/
+void Logger_crash::run(int signal) {
+    if (ran_.exchange(true, std::memory_order_acq_rel)) return;
+    for (Slot& slot : slots_) {
+        Handler handler = slot.handler.load(std::memory_order_acquire);
+        if (handler) handler(slot.context.load(std::memory_order_relaxed), signal);
+    }
+}
+
+/**
+* @brief            Signal handler - run the functions, then let the previous handler deal with the signal.
+*/
+void Logger_crash::on_signal(int signal) {
+    run(signal);
+    restore(signal);
+    std::raise(signal);
+}
+
+/**
+* @brief            Terminate handler - run the functions, then end the process as before install().
+*/
+void Logger_crash::on_terminate() {
+    run(0);
+    if (previous_terminate_) previous_terminate_();
+    std::abort();
+}
+
+/**
+* @brief            Put back the handler a signal had before install().
+*/
+void Logger_crash::restore(int signal) {
+    for (std::size_t i = 0; i < Signal_count; i++) {
+        if (Crash_signals[i] != signal) continue;
+#ifdef _WIN32
+        std::signal(signal, previous_handlers[i] == SIG_ERR ? SIG_DFL : previous_handlers[i]);
+#else
+        sigaction(signal, &previous_actions[i], nullptr);
+#endif
+    }
+}
+
+/**
+* @brief            Open a file for appending, creating it if needed.
+* @param binary     Write line ends as they are; only Windows translates them otherwise.
+* @return           The descriptor, or -1.
+*/
+int Logger_crash::open_append(const char* path, bool binary) {
+#ifdef _WIN32
+    return _open(path, _O_WRONLY | _O_CREAT | _O_APPEND | (binary ? _O_BINARY : _O_TEXT), _S_IREAD | _S_IWRITE);
+#else
+    (void)binary;
+    int fd;
+    do {
+        fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    } while (fd < 0 && errno == EINTR);
+    return fd;
+#endif
+}
+
+/**
+* @brief            Write all of data, continuing after short writes; gives up when the descriptor fails.
+*/
+void Logger_crash::write_all(int fd, const char* data, std::size_t length) {
+    if (fd < 0) return;
+    while (length > 0) {
+#ifdef _WIN32
+        int written = _write(fd, data, static_cast<unsigned int>(std::min<std::size_t>(length, INT_MAX)));
+#else
+        ssize_t written = write(fd, data, length);
+        if (written < 0 && errno == EINTR) continue;
+#endif
+        if (written <= 0) return;
+        data += written;
+        length -= static_cast<std::size_t>(written);
+    }
+}
+
+void Logger_crash::close_file(int fd) {
+    if (fd < 0) return;
+#ifdef _WIN32
+    _close(fd);
+#else
+    close(fd);
+#endif
+}
+
+/**
+* @brief            Sleep for about a millisecond, for a handler waiting on another thread.
+*/
+void Logger_crash::nap() {
+#ifdef _WIN32
+    Sleep(1);
+#else
+    struct timespec time = { 0, 1000000 };
+    nanosleep(&time, nullptr);
+#endif
+}
+
+/**
+* @brief            Destructor - write what is buffered, and close the file if the writer opened it.
+*/
+Logger_crash::Writer::~Writer() {
+    flush();
+    if (owned_) close_file(fd_);
+}
+
+/**
+* @brief            Open a file to append to, creating it if needed.
+*/
+bool Logger_crash::Writer::open(const char* path) {
+    flush();
+    if (owned_) close_file(fd_);
+    fd_ = open_append(path);
+    owned_ = fd_ >= 0;
+    return owned_;
+}
+
+void Logger_crash::Writer::append(const char* data, std::size_t length) {
+    while (length > 0) {
+        if (used_ == sizeof(buffer_)) flush();
+        std::size_t part = std::min(length, sizeof(buffer_) - used_);
+        std::memcpy(buffer_ + used_, data, part);
+        used_ += part;
+        data += part;
+        length -= part;
+    }
+}
+
+void Logger_crash::Writer::append(const char* text) {
+    append(text, std::strlen(text));
+}
+
+/**
+* @brief            Append the decimal digits of value.
+*/
+void Logger_crash::Writer::append_uint(std::uint64_t value) {
+    char digits[20];
+    char* cursor = digits + sizeof(digits);
+    do {
+        *--cursor = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    append(cursor, digits + sizeof(digits) - cursor);
+}
+
+void Logger_crash::Writer::flush() {
+    write_all(fd_, buffer_, used_);
+    used_ = 0;
+}
@@ -0,0 +1,35 @@
+#include "../headers/Logger_decode.hh"
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+
+/**
+ * @brief Offline decoder for files written by Logger_async::Binary_Log.
+ *
+ * Usage:
+ * @code
+ *   Logger_decode logs/log.bin            // "[time] - [thread]\t- message" lines, as File_Log writes them
+ *   Logger_decode logs/log.bin --csv      // time,thread,level,message rows, as CSV_Log writes them
+ * @endcode
+ */
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <file.bin> [--csv]" << std::endl;
+        return 1;
+    }
+    bool csv = argc > 2 && std::strcmp(argv[2], "--csv") == 0;
+
+    std::ifstream in(argv[1], std::ios::in | std::ios::binary);
+    Logger_decode::Result result = Logger_decode::decode(in, std::cout, csv);
+    std::cout.flush();
+
+    if (result.rejected) std::cerr << argv[1] << ": skipped " << result.rejected << " corrupt records" << std::endl;
+    if (result.truncated) std::cerr << argv[1] << ": file ends inside a block, decoded up to the last complete record" << std::endl;
+    if (!result.error.empty()) {
+        std::cerr << argv[1] << ": " << result.error << ", stopping" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,374 @@
+#include "../headers/Logger_file.hh"
+#include "../headers/Logger_crash.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+/**
+* @brief            Open a file for appending log data.
+* @param path       The file to write.
+* @param append_    Keep the existing contents instead of truncating the file.
+* @param backend    How data reaches the file, see Logger_file::Backend.
+* @param binary     Open the Stream backend in binary mode. The raw backends never translate line ends.
+*/
+Logger_file::Logger_file(const std::string& path, bool append_, Backend backend, bool binary)
+    : backend_(backend), path_(path), binary_(binary), fd_(-1), used_chunks_(0), block_buffer_(nullptr), block_capacity_(0), block_used_(0),
+      block_offset_(0), file_size_(0), pending_(0), bytes_(0), syscalls_(0), failures_(0), lost_(0), last_error_(0), opened_(std::chrono::steady_clock::now()) {
+    if (backend_ != Backend::Stream && !open_raw(path, append_, backend_ == Backend::Direct)) {
+        if (backend_ == Backend::Direct && open_raw(path, append_, false)) backend_ = Backend::Vectored;
+        else                                                              backend_ = Backend::Stream;
+    }
+    if (backend_ != Backend::Stream) return;
+
+    std::ios::openmode mode = std::ios::out | (append_ ? std::ios::app : std::ios::trunc);
+    if (binary) mode |= std::ios::binary;
+    stream_.open(path, mode);
+    if (append_ && stream_.is_open()) {
+        std::ifstream existing(path, std::ios::in | std::ios::binary | std::ios::ate);
+        if (existing.is_open()) file_size_ = static_cast<std::uint64_t>(existing.tellg());
+    }
+}
+
+/**
+* @brief            Destructor - write what is left and close the file.
+*/
+Logger_file::~Logger_file() {
+    flush();
+    close_raw();
+    std::free(block_buffer_);
+}
+
+bool Logger_file::is_open() const {
+    return backend_ == Backend::Stream ? stream_.is_open() : fd_ >= 0;
+}
+
+/**
+* @brief            Whether data is waiting for the next flush().
+*/
+bool Logger_file::empty() const {
+    return pending_ == 0;
+}
+
+/**
+* @brief            Length of the file including data not flushed yet.
+*/
+std::uint64_t Logger_file::size() const {
+    return file_size_ + pending_;
+}
+
+/**
+* @brief            Copy data into the write buffer.
+* @param data       Bytes to write.
+* @param length     Number of bytes.
+*/
+void Logger_file::append(const char* data, std::size_t length) {
+    pending_ += length;
+    if (backend_ == Backend::Stream) {
+        buffer_.append(data, length);
+        return;
+    }
+
+    if (backend_ == Backend::Direct) {
+        while (length > 0) {
+            if (block_used_ == block_capacity_) write_blocks(false);
+            std::size_t part = std::min(length, block_capacity_ - block_used_);
+            std::memcpy(block_buffer_ + block_used_, data, part);
+            block_used_ += part;
+            data += part;
+            length -= part;
+        }
+        return;
+    }
+
+    while (length > 0) {
+        if (used_chunks_ == 0 || chunks_[used_chunks_ - 1].size() == Chunk_size) {
+            if (used_chunks_ == chunks_.size()) {
+                chunks_.emplace_back();
+#ifndef _WIN32
+                vectors_.resize(chunks_.size());
+#endif
+            }
+            chunks_[used_chunks_].clear();
+            chunks_[used_chunks_].reserve(Chunk_size);
+            used_chunks_++;
+        }
+        std::string& chunk = chunks_[used_chunks_ - 1];
+        std::size_t part = std::min(length, Chunk_size - chunk.size());
+        chunk.append(data, part);
+        data += part;
+        length -= part;
+    }
+}
+
+/**
+* @brief            Hand all buffered data to the operating system.
+*/
+void Logger_file::flush() {
+    if (pending_ == 0) return;
+
+    if (backend_ == Backend::Stream) {
+        stream_.write(buffer_.data(), buffer_.size());
+        stream_.flush();
+        syscalls_.fetch_add(1, std::memory_order_relaxed);
+        if (stream_) {
+            bytes_.fetch_add(buffer_.size(), std::memory_order_relaxed);
+        }
+        else {
+            count_failure(buffer_.size(), errno);
+            stream_.clear();
+        }
+        buffer_.clear();
+    }
+    else if (backend_ == Backend::Direct) {
+        write_blocks(true);
+    }
+    else {
+        write_chunks();
+    }
+    file_size_ += pending_;
+    pending_ = 0;
+}
+
+/**
+* @brief            Write the data not flushed yet from a fatal signal handler.
+*
+* Only open(), write(), pwrite() and ftruncate() are used and nothing is allocated, so the Stream
+* backend writes its buffer through a descriptor of its own instead of the std::ofstream. A flush()
+* the crash interrupted may have written part of the data already.
+*/
+void Logger_file::crash_flush() {
+    if (pending_ == 0) return;
+
+    if (backend_ == Backend::Stream) {
+        int fd = Logger_crash::open_append(path_.c_str(), binary_);
+        Logger_crash::write_all(fd, buffer_.data(), buffer_.size());
+        Logger_crash::close_file(fd);
+        buffer_.clear();
+    }
+    else if (backend_ == Backend::Direct) {
+        write_blocks(true);
+    }
+    else {
+        for (std::size_t i = 0; i < used_chunks_; i++)
+            Logger_crash::write_all(fd_, chunks_[i].data(), chunks_[i].size());
+        used_chunks_ = 0;
+    }
+    file_size_ += pending_;
+    pending_ = 0;
+}
+
+/**
+* @brief            Bytes passed to the operating system and system calls used, since the file was opened.
+*
+* With the Stream backend the system calls are counted as one per flush(); the library may split a
+* large write further.
+*/
+Logger_file::Stats Logger_file::stats() const {
+    Stats stats;
+    stats.bytes = bytes_.load(std::memory_order_relaxed);
+    stats.syscalls = syscalls_.load(std::memory_order_relaxed);
+    stats.failures = failures_.load(std::memory_order_relaxed);
+    stats.lost = lost_.load(std::memory_order_relaxed);
+    stats.last_error = last_error_.load(std::memory_order_relaxed);
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - opened_).count();
+    return stats;
+}
+
+/**
+* @brief            Open the descriptor of a raw backend.
+* @param direct     Bypass the page cache (O_DIRECT) and set up the aligned block buffer.
+* @return           False if the file cannot be opened this way.
+*/
+bool Logger_file::open_raw(const std::string& path, bool append_, bool direct) {
+#ifdef _WIN32
+    // Unbuffered Win32 handles need sector-aligned writes at sector-aligned offsets, which the
+    // CRT descriptors used here cannot express - Direct falls back to Vectored.
+    if (direct) return false;
+    int flags = _O_WRONLY | _O_CREAT | _O_BINARY | (append_ ? _O_APPEND : _O_TRUNC);
+    fd_ = _open(path.c_str(), flags, _S_IREAD | _S_IWRITE);
+    if (fd_ < 0) return false;
+    if (append_) file_size_ = static_cast<std::uint64_t>(_lseeki64(fd_, 0, SEEK_END));
+    return true;
+#else
+    int flags = O_WRONLY | O_CREAT | (append_ ? 0 : O_TRUNC);
+    if (!direct) {
+        flags |= O_APPEND;
+    }
+    else {
+#ifdef O_DIRECT
+        flags |= O_DIRECT;
+#else
+        return false;
+#endif
+    }
+    fd_ = open(path.c_str(), flags, 0644);
+    if (fd_ < 0) return false;
+
+    struct stat info;
+    if (fstat(fd_, &info) == 0) file_size_ = static_cast<std::uint64_t>(info.st_size);
+    if (!direct) return true;
+
+    // Writes start at the block holding the end of the file, whose existing bytes are read back
+    // so rewriting the block keeps them.
+    block_capacity_ = 256 * Block_size;
+    void* buffer = nullptr;
+    if (posix_memalign(&buffer, Block_size, block_capacity_) != 0) {
+        close_raw();
+        return false;
+    }
+    block_buffer_ = static_cast<char*>(buffer);
+    block_used_ = static_cast<std::size_t>(file_size_ % Block_size);
+    block_offset_ = file_size_ - block_used_;
+    if (block_used_ > 0 && pread(fd_, block_buffer_, Block_size, static_cast<off_t>(block_offset_)) < static_cast<ssize_t>(block_used_)) {
+        close_raw();
+        return false;
+    }
+    return true;
+#endif
+}
+
+/**
+* @brief            Vectored backend - write every filled chunk with as few writev() calls as possible.
+*
+* Short writes continue where the call stopped and calls interrupted by a signal are repeated; any
+* other error drops what is left of the pass and is counted in stats().
+*/
+void Logger_file::write_chunks() {
+    if (fd_ < 0) {
+        used_chunks_ = 0;
+        return;
+    }
+#ifdef _WIN32
+    for (std::size_t i = 0; i < used_chunks_; i++) {
+        const std::string& chunk = chunks_[i];
+        std::size_t done = 0;
+        while (done < chunk.size()) {
+            int written = _write(fd_, chunk.data() + done, static_cast<unsigned int>(chunk.size() - done));
+            syscalls_.fetch_add(1, std::memory_order_relaxed);
+            if (written <= 0) break;
+            done += static_cast<std::size_t>(written);
+        }
+        bytes_.fetch_add(done, std::memory_order_relaxed);
+        if (done < chunk.size()) {
+            std::uint64_t lost = chunk.size() - done;
+            for (std::size_t j = i + 1; j < used_chunks_; j++) lost += chunks_[j].size();
+            count_failure(lost, errno);
+            break;
+        }
+    }
+#else
+#ifdef IOV_MAX
+    static const std::size_t Max_vectors = IOV_MAX;
+#else
+    static const std::size_t Max_vectors = 16;
+#endif
+    for (std::size_t i = 0; i < used_chunks_; i++) {
+        vectors_[i].iov_base = &chunks_[i][0];
+        vectors_[i].iov_len = chunks_[i].size();
+    }
+
+    std::size_t first = 0;
+    while (first < used_chunks_) {
+        int count = static_cast<int>(std::min(Max_vectors, used_chunks_ - first));
+        ssize_t written = writev(fd_, &vectors_[first], count);
+        syscalls_.fetch_add(1, std::memory_order_relaxed);
+        if (written < 0 && errno == EINTR) continue;
+        if (written < 0) {
+            std::uint64_t lost = 0;
+            for (std::size_t i = first; i < used_chunks_; i++) lost += vectors_[i].iov_len;
+            count_failure(lost, errno);
+            break;
+        }
+        bytes_.fetch_add(static_cast<std::uint64_t>(written), std::memory_order_relaxed);
+
+        // Skip what was written; a short write leaves the rest of a chunk for the next call.
+        std::size_t left = static_cast<std::size_t>(written);
+        while (first < used_chunks_ && left >= vectors_[first].iov_len) left -= vectors_[first++].iov_len;
+        if (first < used_chunks_) {
+            vectors_[first].iov_base = static_cast<char*>(vectors_[first].iov_base) + left;
+            vectors_[first].iov_len -= left;
+        }
+    }
+#endif
+    used_chunks_ = 0;
+}
+
+/**
+* @brief            Direct backend - write the block buffer at its aligned file offset.
+* @param final      Also write the last partial block (zero-padded) and cut the file to its real length.
+*                   Otherwise only complete blocks are written.
+*
+* O_DIRECT takes only block-aligned offsets and lengths, so a short pwrite() is continued from the
+* last whole block it wrote, writing the part of a block it had written again. A call interrupted
+* by a signal is repeated; any other error, or a write of less than one block, drops the rest and
+* is counted in stats().
+*/
+void Logger_file::write_blocks(bool final) {
+#ifndef _WIN32
+    std::size_t complete = block_used_ / Block_size * Block_size;
+    std::size_t length = final ? (block_used_ + Block_size - 1) / Block_size * Block_size : complete;
+    if (length == 0 || fd_ < 0) return;
+    std::memset(block_buffer_ + block_used_, 0, length - block_used_);
+
+    std::size_t done = 0;
+    while (done < length) {
+        ssize_t written = pwrite(fd_, block_buffer_ + done, length - done, static_cast<off_t>(block_offset_ + done));
+        syscalls_.fetch_add(1, std::memory_order_relaxed);
+        if (written < 0 && errno == EINTR) continue;
+        if (written < static_cast<ssize_t>(Block_size)) {
+            count_failure(std::min(length, block_used_) - done, written < 0 ? errno : EIO);
+            break;
+        }
+        done += static_cast<std::size_t>(written) / Block_size * Block_size;
+    }
+    bytes_.fetch_add(std::min(done, block_used_), std::memory_order_relaxed);
+
+    if (final && complete != block_used_ && done == length) {
+        syscalls_.fetch_add(1, std::memory_order_relaxed);
+        if (ftruncate(fd_, static_cast<off_t>(block_offset_ + block_used_)) != 0) count_failure(0, errno);
+    }
+
+    // The partial block stays in memory; the next write starts over at its offset.
+    std::memmove(block_buffer_, block_buffer_ + complete, block_used_ - complete);
+    block_used_ -= complete;
+    block_offset_ += complete;
+#else
+    (void)final;
+#endif
+}
+
+/**
+* @brief            Count a failed write and the bytes it dropped.
+*/
+void Logger_file::count_failure(std::uint64_t lost, int error) {
+    failures_.fetch_add(1, std::memory_order_relaxed);
+    lost_.fetch_add(lost, std::memory_order_relaxed);
+    last_error_.store(error, std::memory_order_relaxed);
+}
+
+/**
+* @brief            Close the descriptor of a raw backend.
+*/
+void Logger_file::close_raw() {
+    if (fd_ < 0) return;
+#ifdef _WIN32
+    _close(fd_);
+#else
+    close(fd_);
+#endif
+    fd_ = -1;
+}
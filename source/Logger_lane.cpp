@@ -0,0 +1,410 @@
+#include "../headers/Logger_async.hh"
+
+/**
+* @brief            Start the worker thread of an output.
+* @param logger     The logger whose flush policy the lane follows.
+* @param output     The output written by this lane; the lane keeps it open until it finishes.
+*/
+Logger_async::Lane::Lane(Logger_async& logger, const std::shared_ptr<Output>& output)
+    : logger_(logger), output_(output), in_output_(false), queued_(0), sleeping_(false), closing_(false), finished_(false),
+      dirty_(false), pending_bytes_(0), reported_dropped_(output->dropped_.load(std::memory_order_relaxed)),
+      last_flush_(std::chrono::steady_clock::now()) {
+    queue_.reserve(Work_reserve);
+    work_.reserve(Work_reserve);
+    spare_indices_.reserve(Work_reserve);
+    entry_message_.reserve(Item_reserve);
+    entry_line_.reserve(Item_reserve);
+    thread_ = std::thread(&Lane::run, this);
+}
+
+/**
+* @brief            Destructor - write everything queued, flush and end the thread.
+*/
+Logger_async::Lane::~Lane() {
+    close();
+    if (thread_.joinable()) thread_.join();
+}
+
+/**
+* @brief            Queue the items staged for this lane in batch. Daemon only.
+* @return           False if every item was dropped; the lane then does not hold the batch.
+*
+* If the items do not fit in the logger's lane capacity, those whose level drops on overload are
+* dropped and the rest are queued anyway. Once the lane holds the capacity or more, the output is
+* marked full and claim_record() holds up the threads routed to it, so a stuck output never loses
+* blocking messages and never holds up the daemon or the other outputs.
+*/
+bool Logger_async::Lane::submit(Batch* batch) {
+    std::size_t capacity = logger_.lane_capacity_.load(std::memory_order_relaxed);
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queued_ + staging.size() > capacity) {
+            std::size_t kept = 0;
+            for (std::uint32_t index : staging) {
+                if (must_keep(batch->items[index].record)) staging[kept++] = index;
+                else batch->items[index].unwritten.fetch_sub(1, std::memory_order_relaxed);
+            }
+            output_->dropped_.fetch_add(staging.size() - kept, std::memory_order_relaxed);
+            staging.resize(kept);
+            if (kept == 0) return false;
+        }
+        std::size_t count = staging.size();
+
+        queue_.emplace_back();
+        queue_.back().batch = batch;
+        queue_.back().indices.swap(staging);
+        if (!spare_indices_.empty()) {
+            staging.swap(spare_indices_.back());
+            spare_indices_.pop_back();
+        }
+        queued_ += count;
+        output_->backlog_.store(queued_, std::memory_order_relaxed);
+        if (queued_ > output_->max_backlog_.load(std::memory_order_relaxed))
+            output_->max_backlog_.store(queued_, std::memory_order_relaxed);
+        if (queued_ >= capacity) output_->full_.store(true, std::memory_order_release);
+        wake = sleeping_;
+    }
+    if (wake) condition_.notify_one();
+    return true;
+}
+
+/**
+* @brief            Check whether a record must wait for room rather than be dropped when the lane is full.
+*
+* Control messages always wait; other records follow the overload policy of their level, where
+* Spill waits too, as the daemon cannot spill on the producer's behalf.
+*/
+bool Logger_async::Lane::must_keep(const Record& record) const {
+    if (!record.format && (record.message == logger_.Thread_REMOVE || record.message == logger_.Lg_STOP)) return true;
+    LogLevel level = record.has_level ? record.level : LogLevel::INFO;
+    Overload_policy policy = logger_.overload_policies_[static_cast<int>(level)].load(std::memory_order_relaxed);
+    return policy == Overload_policy::Block || policy == Overload_policy::Spill;
+}
+
+/**
+* @brief            Queue a flush() barrier behind the batches already submitted. Daemon only.
+* @return           False if the thread has ended; everything it was given is flushed then.
+*/
+bool Logger_async::Lane::submit_barrier(const std::shared_ptr<Flush_barrier>& barrier) {
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (finished_) return false;
+        queue_.emplace_back();
+        queue_.back().batch = nullptr;
+        queue_.back().barrier = barrier;
+        wake = sleeping_;
+    }
+    if (wake) condition_.notify_one();
+    return true;
+}
+
+/**
+* @brief            Let the thread end once it has written what is queued.
+*/
+void Logger_async::Lane::close() {
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closing_ = true;
+        wake = sleeping_;
+    }
+    if (wake) condition_.notify_one();
+}
+
+/**
+* @brief            Cancel close() because the output is routed again.
+* @return           False if the thread has already ended; a new lane is needed then.
+*/
+bool Logger_async::Lane::reopen() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (finished_) return false;
+    closing_ = false;
+    return true;
+}
+
+/**
+* @brief            Check whether the thread has ended after close().
+*/
+bool Logger_async::Lane::finished() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return finished_;
+}
+
+/**
+* @brief            Lane thread - write queued batches to the output and flush it by the flush policy.
+*
+* The thread takes everything queued at once by swapping the queue with its own list, and hands the
+* index lists back for the daemon to reuse.
+*/
+void Logger_async::Lane::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        if (queue_.empty()) {
+            if (dirty_ && flush_due(true)) {
+                lock.unlock();
+                enter_output();
+                flush();
+                leave_output();
+                lock.lock();
+                continue;
+            }
+            if (closing_) break;
+
+            sleeping_ = true;
+            if (dirty_) condition_.wait_until(lock, last_flush_ + std::chrono::milliseconds(logger_.flush_value_.load(std::memory_order_relaxed)));
+            else        condition_.wait(lock);
+            sleeping_ = false;
+            continue;
+        }
+
+        work_.swap(queue_);
+        lock.unlock();
+        enter_output();
+
+        std::size_t written = 0;
+        for (Work& work : work_) {
+            if (work.barrier) {
+                if (dirty_) flush();
+                work.barrier->arrive();
+                work.barrier.reset();
+                continue;
+            }
+
+            std::uint64_t start = Logger_clock::now();
+            std::size_t bytes = 0;
+            for (std::uint32_t index : work.indices) {
+                const Batch_item& item = work.batch->items[index];
+                Log_entry entry(item, time_formatter_, entry_message_, entry_line_);
+                output_->write_record(entry);
+                item.unwritten.fetch_sub(1, std::memory_order_release);
+                if (logger_.crashing_.load(std::memory_order_relaxed)) {
+                    leave_output();
+                    crash_park();
+                }
+                bytes += item.has_line ? item.line.size() + 1 : item.record.args_size + 24;
+            }
+            std::uint64_t end = Logger_clock::now();
+            count_latency(*work.batch, work.indices, end);
+            pending_bytes_ += bytes;
+            dirty_ = true;
+            written += work.indices.size();
+            output_->written_.fetch_add(work.indices.size(), std::memory_order_relaxed);
+            output_->bytes_.fetch_add(bytes, std::memory_order_relaxed);
+            output_->write_ns_.fetch_add(end - start, std::memory_order_relaxed);
+            report_dropped();
+            logger_.release_batch(work.batch);
+            if (flush_due(false)) flush();
+        }
+        leave_output();
+
+        lock.lock();
+        queued_ -= written;
+        output_->backlog_.store(queued_, std::memory_order_relaxed);
+        if (output_->full_.load(std::memory_order_relaxed) && (queued_ == 0 || queued_ < logger_.lane_capacity_.load(std::memory_order_relaxed))) {
+            {
+                std::lock_guard<std::mutex> room_lock(output_->room_mutex_);
+                output_->full_.store(false, std::memory_order_release);
+            }
+            output_->room_.notify_all();
+        }
+        for (Work& work : work_) {
+            if (work.barrier || work.indices.capacity() == 0) continue;
+            work.indices.clear();
+            spare_indices_.push_back(std::move(work.indices));
+        }
+        work_.clear();
+    }
+
+    lock.unlock();
+    if (dirty_) {
+        enter_output();
+        flush();
+        leave_output();
+    }
+    lock.lock();
+    finished_ = true;
+
+    // Barriers submitted while the last flush ran.
+    for (Work& work : queue_) {
+        if (work.barrier) work.barrier->arrive();
+        else              logger_.release_batch(work.batch);
+    }
+    queue_.clear();
+}
+
+/**
+* @brief            Start calling the output, unless crash_flush() has started - the thread stops then.
+*
+* The flag is raised before crashing_ is read, and crash_flush() raises crashing_ before it reads the
+* flag, so either the lane stops here or crash_flush() waits for leave_output().
+*/
+void Logger_async::Lane::enter_output() {
+    in_output_.store(true, std::memory_order_seq_cst);
+    if (!logger_.crashing_.load(std::memory_order_seq_cst)) return;
+    leave_output();
+    crash_park();
+}
+
+void Logger_async::Lane::leave_output() {
+    in_output_.store(false, std::memory_order_release);
+}
+
+/**
+* @brief            Fatal signal handler - wait for the lane's thread to leave the output, then have
+*                   the output write what it has buffered.
+* @param naps       Waits of about a millisecond crash_flush() has left; the output is left alone if
+*                   they run out first, as its thread may be the one that crashed.
+*
+* The items the thread has not written keep a count above 0, so crash_flush() writes them itself.
+*/
+void Logger_async::Lane::crash_flush(int& naps) {
+    while (in_output_.load(std::memory_order_seq_cst)) {
+        if (naps <= 0) return;
+        naps--;
+        Logger_crash::nap();
+    }
+    output_->crash_flush();
+}
+
+/**
+* @brief            Check the flush policy against what has been written since the last flush.
+* @param idle       True when nothing more is queued for the lane.
+*/
+bool Logger_async::Lane::flush_due(bool idle) {
+    if (!dirty_) return false;
+
+    switch (logger_.flush_policy_.load(std::memory_order_acquire)) {
+    case Flush_policy::Per_batch:
+        return idle;
+    case Flush_policy::Interval:
+        return std::chrono::steady_clock::now() - last_flush_ >= std::chrono::milliseconds(logger_.flush_value_.load(std::memory_order_relaxed));
+    case Flush_policy::Bytes:
+        return idle || pending_bytes_ >= logger_.flush_value_.load(std::memory_order_relaxed);
+    }
+    return true;
+}
+
+/**
+* @brief            Flush the output.
+*/
+void Logger_async::Lane::flush() {
+    std::uint64_t start = Logger_clock::now();
+    output_->flush();
+    output_->write_ns_.fetch_add(Logger_clock::now() - start, std::memory_order_relaxed);
+    dirty_ = false;
+    pending_bytes_ = 0;
+    last_flush_ = std::chrono::steady_clock::now();
+}
+
+/**
+* @brief            Add how long the items written took from add_log() to the logger's write latency histogram.
+* @param end        Clock reading taken once the items were written.
+*
+* The counts are gathered here first, so the shared histogram takes one atomic add per bucket used.
+*/
+void Logger_async::Lane::count_latency(const Batch& batch, const std::vector<std::uint32_t>& indices, std::uint64_t end) {
+    std::uint64_t counts[Latency_buckets] = {};
+    for (std::uint32_t index : indices) {
+        std::uint64_t tick = batch.items[index].record.tick;
+        counts[latency_bucket(end > tick ? end - tick : 0)]++;
+    }
+    for (std::size_t i = 0; i < Latency_buckets; i++) {
+        if (counts[i] != 0) logger_.write_latency_[i].fetch_add(counts[i], std::memory_order_relaxed);
+    }
+}
+
+/**
+* @brief            Write a line about messages the daemon dropped for this output since the last one.
+*/
+void Logger_async::Lane::report_dropped() {
+    std::uint64_t dropped = output_->dropped_.load(std::memory_order_relaxed);
+    if (dropped == reported_dropped_) return;
+
+    char time_text[Logger_time_formatter::Max_length];
+    std::size_t time_length = time_formatter_.format(Logger_clock::now(), time_text);
+    std::string line;
+    line.assign("[").append(time_text, time_length).append("] - [Logger]\t- Logger overload: ");
+    Logger_args::append_uint(dropped - reported_dropped_, line);
+    line.append(" messages dropped by a slow output");
+    output_->write_log(line);
+    reported_dropped_ = dropped;
+}
+
+/**
+* @brief            Counters of the output's lane.
+*/
+Logger_async::Output::Stats Logger_async::Output::stats() const {
+    Stats stats;
+    stats.written = written_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    stats.backlog = backlog_.load(std::memory_order_relaxed);
+    stats.max_backlog = max_backlog_.load(std::memory_order_relaxed);
+    stats.bytes = bytes_.load(std::memory_order_relaxed);
+    stats.write_ns = write_ns_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+/**
+* @brief            View of a batch item for one output call.
+* @param item       The item; the lane keeps its batch alive while the entry is used.
+* @param time_formatter Formatter of the lane, used if the daemon did not build the line.
+* @param message_buffer, line_buffer Strings of the lane that text built for this entry is kept in.
+*/
+Logger_async::Log_entry::Log_entry(const Batch_item& item, Logger_time_formatter& time_formatter, std::string& message_buffer, std::string& line_buffer)
+    : tick(item.record.tick), thread_id(item.record.thread_id), format(item.record.format),
+      args(record_args(item.record)), args_size(item.record.args_size), level(item.record.level), has_level(item.record.has_level),
+      item_(item), time_formatter_(time_formatter), message_(message_buffer), line_(line_buffer), has_message_(false), has_line_(false) {}
+
+/**
+* @brief  Wall-clock time of the message in nanoseconds since the Unix epoch.
+*/
+std::int64_t Logger_async::Log_entry::wall_ns() const {
+    return item_.wall_ns;
+}
+
+/**
+* @brief  Write the wall-clock time of the message as text, without a terminating zero.
+* @param  out Buffer of at least Logger_time_formatter::Max_length characters.
+* @return Number of characters written.
+*/
+std::size_t Logger_async::Log_entry::format_time(char* out) const {
+    return time_formatter_.format_wall(item_.wall_ns, out);
+}
+
+/**
+* @brief  Id of the logging thread as text, or the name given to it with set_thread_name().
+*/
+const std::string& Logger_async::Log_entry::thread_text() const {
+    return *item_.thread_text;
+}
+
+/**
+* @brief  Text of the message, rendered from its format and arguments if the daemon has not.
+*/
+const std::string& Logger_async::Log_entry::message() const {
+    if (!format) return item_.record.message;
+    if (item_.has_line) return item_.message;
+    if (!has_message_) {
+        message_.clear();
+        Logger_args::render(format, args, args_size, message_);
+        has_message_ = true;
+    }
+    return message_;
+}
+
+/**
+* @brief  The message as a "[time] - [thread]\t- [LEVEL] message" log line.
+*/
+const std::string& Logger_async::Log_entry::line() const {
+    if (item_.has_line) return item_.line;
+    if (!has_line_) {
+        char time_text[Logger_time_formatter::Max_length];
+        std::size_t time_length = time_formatter_.format_wall(item_.wall_ns, time_text);
+        line_.clear();
+        append_line(line_, time_text, time_length, thread_text(), level, has_level, message());
+        has_line_ = true;
+    }
+    return line_;
+}
@@ -0,0 +1,272 @@
+#include "../headers/Logger_async.hh"
+#include "../headers/Logger_sync.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+/**
+ * @brief Throughput and latency benchmark of the loggers.
+ *
+ * Every run starts a fresh logger, lets num_threads producers log their share of the messages
+ * at once and ends when the logger has been destroyed, so everything has reached the sink. For
+ * each run one CSV row is written with:
+ *  - messages_per_sec:  messages divided by the time from the first add_log() to the last byte written.
+ *  - add_*_ns:          percentiles of the time a producer spends inside one add_log() / log() call.
+ *  - e2e_*_ns:          percentiles of the time from add_log() until the sink was flushed with the
+ *                       message in it. Logger_sync writes before log() returns, so there it equals add_*_ns.
+ *
+ * Sinks are "null" (formats the line and discards it), "file" (File_Log), "csv" (CSV_Log) and
+ * "console" (Console_Log with stdout redirected to the null device). Logger_sync always writes to
+ * the console as well, so its "file" rows include that cost.
+ *
+ * Usage: Logger_load_bench [messages per run] [results.csv]
+ */
+
+using Bench_clock = std::chrono::steady_clock;
+
+static const char* const Null_device =
+#ifdef _WIN32
+    "NUL";
+#else
+    "/dev/null";
+#endif
+
+/**
+ * @brief Latency percentiles of a set of samples, in nanoseconds.
+ */
+struct Percentiles {
+    std::uint64_t p50;
+    std::uint64_t p99;
+    std::uint64_t p999;
+};
+
+/**
+ * @brief                   Sort samples and pick the 50th, 99th and 99.9th percentiles.
+ */
+static Percentiles percentiles(std::vector<std::uint64_t>& samples) {
+    Percentiles result = {0, 0, 0};
+    if (samples.empty()) return result;
+    std::sort(samples.begin(), samples.end());
+    std::size_t last = samples.size() - 1;
+    result.p50 = samples[last * 50 / 100];
+    result.p99 = samples[last * 99 / 100];
+    result.p999 = samples[last * 999 / 1000];
+    return result;
+}
+
+/**
+ * @brief Output that formats every line and throws it away, to measure the logger without a sink.
+ */
+class Null_Log : public Logger_async::Output {
+    public:
+        void write_log(const std::string& message) override { bytes_ += message.size(); }
+    private:
+        std::size_t bytes_ = 0;
+};
+
+/**
+ * @brief Wraps the measured output and records how long each message took to be flushed by it.
+ *
+ * Only the output's lane calls it, so the samples need no lock; they are read after the logger
+ * has been destroyed.
+ */
+class Probe_Log : public Logger_async::Output {
+    public:
+        Probe_Log(std::shared_ptr<Logger_async::Output> output, std::size_t expected) : output_(std::move(output)) {
+            pending_.reserve(4096);
+            samples.reserve(expected);
+        }
+
+        void write_log(const std::string& message) override { output_->write_log(message); }
+
+        void write_record(const Logger_async::Log_entry& entry) override {
+            output_->write_record(entry);
+            pending_.push_back(entry.tick);
+        }
+
+        void flush() override {
+            output_->flush();
+            std::uint64_t now = Logger_clock::now();
+            for (std::uint64_t tick : pending_) samples.push_back(now - tick);
+            pending_.clear();
+        }
+
+        bool needs_line() const override { return output_->needs_line(); }
+
+        std::vector<std::uint64_t> samples;
+
+    private:
+        std::shared_ptr<Logger_async::Output> output_;
+        std::vector<std::uint64_t> pending_;
+};
+
+/**
+ * @brief Result of one run.
+ */
+struct Bench_result {
+    double seconds;
+    std::vector<std::uint64_t> add_samples;
+    std::vector<std::uint64_t> e2e_samples;
+};
+
+/**
+ * @brief                   Build the payload that makes a "Bench {} {}" message about message_bytes long.
+ */
+static std::string make_payload(std::size_t message_bytes) {
+    return std::string(message_bytes > 16 ? message_bytes - 16 : 1, 'x');
+}
+
+/**
+ * @brief                   Start num_threads producers together and collect their add_log() latencies.
+ * @param log               Called by a producer for each message with its index; returns nothing.
+ * @param setup             Called once by every producer before the start, e.g. to add its outputs.
+ * @return                  Latency samples of all producers.
+ */
+template <typename Setup, typename Log>
+static std::vector<std::uint64_t> run_producers(int num_threads, int num_messages, Setup setup, Log log) {
+    std::vector<std::vector<std::uint64_t>> samples(num_threads);
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+
+    std::vector<std::thread> producers;
+    for (int t = 0; t < num_threads; t++) {
+        int count = num_messages / num_threads + (t < num_messages % num_threads ? 1 : 0);
+        std::vector<std::uint64_t>* own = &samples[t];
+        producers.push_back(std::thread([&, count, own] {
+            own->reserve(count);
+            setup();
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+
+            for (int i = 0; i < count; i++) {
+                std::uint64_t start = Logger_clock::now();
+                log(i);
+                own->push_back(Logger_clock::now() - start);
+            }
+        }));
+    }
+    while (ready.load() < num_threads) std::this_thread::yield();
+    go.store(true, std::memory_order_release);
+    for (auto& producer : producers) producer.join();
+
+    std::vector<std::uint64_t> all;
+    all.reserve(num_messages);
+    for (auto& own : samples) all.insert(all.end(), own.begin(), own.end());
+    return all;
+}
+
+/**
+ * @brief                   Log num_messages through Logger_async to one sink.
+ * @param sink              "null", "file", "csv" or "console".
+ */
+static Bench_result bench_async(const std::string& sink, int num_threads, int num_messages, std::size_t message_bytes) {
+    std::string path = sink == "csv" ? "logs/bench_async.csv" : "logs/bench_async.log";
+    std::shared_ptr<Logger_async::Output> output;
+    if (sink == "file")         output = std::make_shared<Logger_async::File_Log>(path, false);
+    else if (sink == "csv")     output = std::make_shared<Logger_async::CSV_Log>(path, false);
+    else if (sink == "console") output = std::make_shared<Logger_async::Console_Log>();
+    else                        output = std::make_shared<Null_Log>();
+    std::shared_ptr<Probe_Log> probe = std::make_shared<Probe_Log>(output, num_messages);
+    output.reset();
+
+    const std::string payload = make_payload(message_bytes);
+    Bench_result result;
+    Bench_clock::time_point start;
+    {
+        std::unique_ptr<Logger_async> logger(new Logger_async());
+        start = Bench_clock::now();
+        result.add_samples = run_producers(num_threads, num_messages,
+            [&] { logger->add_output(std::this_thread::get_id(), probe); },
+            [&](int i) { logger->add_log(std::this_thread::get_id(), "Bench {} {}", i, payload); });
+    }
+    result.seconds = std::chrono::duration<double>(Bench_clock::now() - start).count();
+    result.e2e_samples.swap(probe->samples);
+    return result;
+}
+
+/**
+ * @brief                   Log num_messages through Logger_sync.
+ * @param sink              "console", or "file" for the console plus a file.
+ */
+static Bench_result bench_sync(const std::string& sink, int num_threads, int num_messages, std::size_t message_bytes) {
+    const std::string payload = make_payload(message_bytes);
+    Bench_result result;
+    Bench_clock::time_point start;
+    {
+        Logger_sync logger;
+        if (sink == "file")
+            logger.add_output(std::unique_ptr<Logger_sync::Output>(new Logger_sync::FileOutput("logs/bench_sync.log")));
+        start = Bench_clock::now();
+        result.add_samples = run_producers(num_threads, num_messages, [] {},
+            [&](int) { logger.log(Logger_sync::LogLevel::INFO, payload); });
+    }
+    result.seconds = std::chrono::duration<double>(Bench_clock::now() - start).count();
+    result.e2e_samples = result.add_samples;
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    int num_messages = argc > 1 ? std::stoi(argv[1]) : 100000;
+    std::string results_path = argc > 2 ? argv[2] : "bench_results.csv";
+
+    // The console sinks write to stdout, so it goes to the null device and the results to a file.
+    if (!std::freopen(Null_device, "w", stdout)) {
+        std::cerr << "Cannot redirect stdout to " << Null_device << std::endl;
+        return 1;
+    }
+    std::ofstream results(results_path);
+    if (!results.is_open()) {
+        std::cerr << "Cannot open " << results_path << std::endl;
+        return 1;
+    }
+
+    const int thread_counts[] = {1, 2, 4, 8, 16, 32, 64};
+    const std::size_t message_sizes[] = {32, 128, 1024};
+    const char* const async_sinks[] = {"null", "file", "csv", "console"};
+    const char* const sync_sinks[] = {"console", "file"};
+
+    const char* header = "logger,sink,threads,message_bytes,messages,seconds,messages_per_sec,"
+                         "add_p50_ns,add_p99_ns,add_p999_ns,e2e_p50_ns,e2e_p99_ns,e2e_p999_ns";
+    results << header << std::endl;
+    std::cerr << header << std::endl;
+
+    auto report = [&](const char* logger, const char* sink, int num_threads, std::size_t message_bytes, Bench_result& result) {
+        Percentiles add = percentiles(result.add_samples);
+        Percentiles e2e = percentiles(result.e2e_samples);
+        std::ostringstream row;
+        row << logger << "," << sink << "," << num_threads << "," << message_bytes << "," << num_messages << ","
+            << result.seconds << "," << static_cast<long long>(num_messages / result.seconds) << ","
+            << add.p50 << "," << add.p99 << "," << add.p999 << ","
+            << e2e.p50 << "," << e2e.p99 << "," << e2e.p999;
+        results << row.str() << std::endl;
+        std::cerr << row.str() << std::endl;
+    };
+
+    for (std::size_t message_bytes : message_sizes) {
+        for (int num_threads : thread_counts) {
+            for (const char* sink : async_sinks) {
+                Bench_result result = bench_async(sink, num_threads, num_messages, message_bytes);
+                report("async", sink, num_threads, message_bytes, result);
+            }
+            for (const char* sink : sync_sinks) {
+                Bench_result result = bench_sync(sink, num_threads, num_messages, message_bytes);
+                report("sync", sink, num_threads, message_bytes, result);
+            }
+        }
+    }
+
+    std::remove("logs/bench_async.log");
+    std::remove("logs/bench_async.csv");
+    std::remove("logs/bench_sync.log");
+    return 0;
+}
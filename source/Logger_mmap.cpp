@@ -0,0 +1,212 @@
+#include "../headers/Logger_async.hh"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#define NOGDI
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+* @brief            Smallest unit a mapping offset can be aligned to.
+*/
+static std::size_t mapping_granularity() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwAllocationGranularity;
+#else
+    return static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+/**
+* @brief                Setting up a memory-mapped file output.
+* @param filename       The name of the file to output to.
+* @param append_        Set mode for output - delete old text or append text.
+* @param segment_size   Bytes the file grows by, and the size of the mapped window.
+*/
+Logger_async::Mmap_Log::Mmap_Log(std::string& filename, bool append_, std::size_t segment_size)
+    : file_(-1), mapping_(0), view_(nullptr), view_offset_(0), view_size_(0), length_(0), synced_(0), stop_sync_(false) {
+    if (filename == "") filename = "logs/log_mmap.txt";
+
+    std::size_t granularity = mapping_granularity();
+    segment_size_ = std::max(granularity, (segment_size + granularity - 1) / granularity * granularity);
+
+    std::uint64_t length = 0;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                              NULL, append_ ? OPEN_ALWAYS : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return;
+    file_ = reinterpret_cast<std::intptr_t>(file);
+    LARGE_INTEGER size;
+    if (append_ && GetFileSizeEx(file, &size)) length = static_cast<std::uint64_t>(size.QuadPart);
+#else
+    int fd = open(filename.c_str(), O_RDWR | O_CREAT | (append_ ? 0 : O_TRUNC), 0644);
+    if (fd < 0) return;
+    file_ = fd;
+    struct stat info;
+    if (append_ && fstat(fd, &info) == 0) length = static_cast<std::uint64_t>(info.st_size);
+#endif
+
+    length_.store(length, std::memory_order_relaxed);
+    synced_ = length;
+    if (!map_segment(length - length % granularity)) return;
+    sync_thread_ = std::thread(&Mmap_Log::sync_thread, this);
+}
+
+/**
+* @brief            Destructor - write back the mapping and cut the file to the written length.
+*/
+Logger_async::Mmap_Log::~Mmap_Log() {
+    if (sync_thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(map_mutex_);
+            stop_sync_ = true;
+        }
+        sync_condition_.notify_one();
+        sync_thread_.join();
+    }
+
+    std::lock_guard<std::mutex> lock(map_mutex_);
+    unmap_segment();
+    std::uint64_t length = length_.load(std::memory_order_relaxed);
+#ifdef _WIN32
+    if (file_ == 0 || file_ == reinterpret_cast<std::intptr_t>(INVALID_HANDLE_VALUE)) return;
+    HANDLE file = reinterpret_cast<HANDLE>(file_);
+    LARGE_INTEGER end;
+    end.QuadPart = static_cast<LONGLONG>(length);
+    SetFilePointerEx(file, end, NULL, FILE_BEGIN);
+    SetEndOfFile(file);
+    FlushFileBuffers(file);
+    CloseHandle(file);
+#else
+    if (file_ < 0) return;
+    int fd = static_cast<int>(file_);
+    if (ftruncate(fd, static_cast<off_t>(length)) != 0) {}
+    fsync(fd);
+    close(fd);
+#endif
+}
+
+/**
+* @brief            Copy a log message into the mapping.
+* @param message    The log message to write.
+*/
+void Logger_async::Mmap_Log::write_log(const std::string& message) {
+    append(message.data(), message.size());
+    append("\n", 1);
+}
+
+/**
+* @brief            Copy bytes at the end of the written data, moving the window on when it is full.
+*/
+void Logger_async::Mmap_Log::append(const char* data, std::size_t length) {
+    std::uint64_t position = length_.load(std::memory_order_relaxed);
+    while (length > 0 && view_) {
+        std::uint64_t view_end = view_offset_ + view_size_;
+        if (position == view_end) {
+            std::lock_guard<std::mutex> lock(map_mutex_);
+            unmap_segment();
+            if (!map_segment(view_end)) break;
+            continue;
+        }
+
+        std::size_t chunk = static_cast<std::size_t>(std::min<std::uint64_t>(length, view_end - position));
+        std::memcpy(view_ + (position - view_offset_), data, chunk);
+        position += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+    length_.store(position, std::memory_order_release);
+}
+
+/**
+* @brief            Extend the file to cover a new window and map it. Needs map_mutex_ once the sync thread runs.
+* @param offset     File offset of the window, a multiple of the mapping granularity.
+*/
+bool Logger_async::Mmap_Log::map_segment(std::uint64_t offset) {
+    std::uint64_t end = offset + segment_size_;
+#ifdef _WIN32
+    if (file_ == 0 || file_ == reinterpret_cast<std::intptr_t>(INVALID_HANDLE_VALUE)) return false;
+    HANDLE file = reinterpret_cast<HANDLE>(file_);
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, static_cast<DWORD>(end >> 32), static_cast<DWORD>(end), NULL);
+    if (mapping == NULL) return false;
+    void* view = MapViewOfFile(mapping, FILE_MAP_WRITE, static_cast<DWORD>(offset >> 32), static_cast<DWORD>(offset), segment_size_);
+    if (view == NULL) {
+        CloseHandle(mapping);
+        return false;
+    }
+    mapping_ = reinterpret_cast<std::intptr_t>(mapping);
+#else
+    if (file_ < 0) return false;
+    int fd = static_cast<int>(file_);
+    struct stat info;
+    if (fstat(fd, &info) != 0) return false;
+    if (static_cast<std::uint64_t>(info.st_size) < end && ftruncate(fd, static_cast<off_t>(end)) != 0) return false;
+    void* view = mmap(NULL, segment_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, static_cast<off_t>(offset));
+    if (view == MAP_FAILED) return false;
+#endif
+    view_ = static_cast<char*>(view);
+    view_offset_ = offset;
+    view_size_ = segment_size_;
+    return true;
+}
+
+/**
+* @brief            Start writing back the current window and unmap it. Needs map_mutex_ once the sync thread runs.
+*/
+void Logger_async::Mmap_Log::unmap_segment() {
+    if (!view_) return;
+#ifdef _WIN32
+    FlushViewOfFile(view_, 0);
+    UnmapViewOfFile(view_);
+    CloseHandle(reinterpret_cast<HANDLE>(mapping_));
+    mapping_ = 0;
+#else
+    msync(view_, view_size_, MS_ASYNC);
+    munmap(view_, view_size_);
+#endif
+    view_ = nullptr;
+}
+
+/**
+* @brief            Background thread - write back newly written pages about once a second.
+*
+* The write-back holds map_mutex_, so the window it writes cannot be unmapped or moved meanwhile;
+* the lane only waits for it when it moves to the next segment. Data written into a window that was
+* unmapped since the last round is written back through the file. synced_ moves only when the
+* write-back succeeded, so a failed round is tried again.
+*/
+void Logger_async::Mmap_Log::sync_thread() {
+    static const std::size_t page = mapping_granularity();
+
+    std::unique_lock<std::mutex> lock(map_mutex_);
+    while (!stop_sync_) {
+        sync_condition_.wait_for(lock, std::chrono::seconds(1));
+        std::uint64_t end = length_.load(std::memory_order_acquire);
+        if (!view_ || end <= synced_) continue;
+
+        end = std::min<std::uint64_t>(end, view_offset_ + view_size_);
+        bool whole_file = synced_ < view_offset_;
+        std::uint64_t start = whole_file ? view_offset_ : synced_ - (synced_ - view_offset_) % page;
+
+        bool ok;
+#ifdef _WIN32
+        ok = end == start || FlushViewOfFile(view_ + (start - view_offset_), static_cast<SIZE_T>(end - start)) != 0;
+        if (ok && whole_file) ok = FlushFileBuffers(reinterpret_cast<HANDLE>(file_)) != 0;
+#else
+        ok = end == start || msync(view_ + (start - view_offset_), static_cast<std::size_t>(end - start), MS_SYNC) == 0;
+        if (ok && whole_file) ok = fsync(static_cast<int>(file_)) == 0;
+#endif
+        if (ok) synced_ = end;
+    }
+}
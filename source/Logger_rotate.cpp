@@ -0,0 +1,222 @@
+#include "../headers/Logger_rotate.hh"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#define NOGDI
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+* @brief            Set up the rotation of a file; nothing runs until the first rotation.
+* @param path       The file that is rotated.
+* @param policy     When to rotate and what to do with the segments.
+*/
+Logger_rotation::Logger_rotation(const std::string& path, const Policy& policy)
+    : path_(path), policy_(policy), compress_(policy.compress), failing_(false), sequence_(0), busy_(false), stop_(false) {
+    schedule(std::time(nullptr));
+    if (compress_ && !policy_.compressor) {
+        compress_ = false;
+        warning_ = "compression needs Policy::compressor; rotated segments stay uncompressed";
+    }
+}
+
+/**
+* @brief            Destructor - compress and prune the segments still queued, then end the thread.
+*/
+Logger_rotation::~Logger_rotation() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    condition_.notify_one();
+    if (thread_.joinable()) thread_.join();
+}
+
+/**
+* @brief            Check whether the file must be rotated before the next write.
+* @param size       Current length of the file, including data not flushed yet.
+* @param length     Bytes about to be written.
+*/
+bool Logger_rotation::due(std::uint64_t size, std::size_t length) {
+    if (size == 0) return false;
+    if (failing_ && std::chrono::steady_clock::now() < retry_after_) return false;
+    if (policy_.max_bytes != 0 && size + length > policy_.max_bytes) return true;
+    return policy_.interval != Interval::None && std::chrono::system_clock::now() >= next_rotation_;
+}
+
+/**
+* @brief            Rename the file to a new segment and queue it for the worker.
+* @param file       The writer's file, open or already closed (nullptr). If the rename succeeds the
+*                   worker takes it over, flushes and closes it, and file is left empty for the
+*                   writer to open the path again.
+* @return           Name of the segment, or "" if the file could not be renamed; the caller then
+*                   keeps appending to it. The first failure in a row leaves a warning to take.
+*/
+std::string Logger_rotation::rotate(std::unique_ptr<Logger_file>& file) {
+    std::time_t now = std::time(nullptr);
+    schedule(now);
+
+    std::string segment = segment_name(now);
+    if (std::rename(path_.c_str(), segment.c_str()) != 0) {
+        int error = errno;
+        if (!failing_) {
+            warning_ = "could not rename " + path_ + " to " + segment + ": " + std::strerror(error)
+                       + "; retrying every " + std::to_string(Retry_seconds) + " s";
+        }
+        failing_ = true;
+        retry_after_ = std::chrono::steady_clock::now() + std::chrono::seconds(static_cast<std::chrono::seconds::rep>(Retry_seconds));
+        return "";
+    }
+    failing_ = false;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(Job());
+        jobs_.back().segment = segment;
+        jobs_.back().file = std::move(file);
+        if (!thread_.joinable()) thread_ = std::thread(&Logger_rotation::worker, this);
+    }
+    condition_.notify_one();
+    return segment;
+}
+
+/**
+* @brief            Block until every rotated segment has been compressed and pruned.
+*/
+void Logger_rotation::wait_idle() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_condition_.wait(lock, [this] { return jobs_.empty() && !busy_; });
+}
+
+/**
+* @brief            Segments rotated by this instance that are still kept, oldest first.
+*/
+std::vector<std::string> Logger_rotation::segments() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::vector<std::string>(segments_.begin(), segments_.end());
+}
+
+/**
+* @brief            What went wrong since the last call, e.g. a failed rename, or "" if nothing.
+*
+* Called by the writer, which reports it once in the file itself.
+*/
+std::string Logger_rotation::take_warning() {
+    std::string warning;
+    warning.swap(warning_);
+    return warning;
+}
+
+/**
+* @brief            Work out when the next time-based rotation is due, in local time.
+*/
+void Logger_rotation::schedule(std::time_t now) {
+    if (policy_.interval == Interval::None) return;
+
+    std::tm local_time;
+#ifdef _WIN32
+    localtime_s(&local_time, &now);
+#else
+    localtime_r(&now, &local_time);
+#endif
+    local_time.tm_sec = 0;
+    local_time.tm_min = 0;
+    if (policy_.interval == Interval::Hourly) {
+        local_time.tm_hour += 1;
+    }
+    else {
+        local_time.tm_hour = 0;
+        local_time.tm_mday += 1;
+    }
+    local_time.tm_isdst = -1;
+    next_rotation_ = std::chrono::system_clock::from_time_t(std::mktime(&local_time));
+}
+
+/**
+* @brief            "<path>.<yyyymmdd-hhmmss>", with ".<n>" added while that name is taken.
+*/
+std::string Logger_rotation::segment_name(std::time_t now) {
+    std::tm local_time;
+#ifdef _WIN32
+    localtime_s(&local_time, &now);
+#else
+    localtime_r(&now, &local_time);
+#endif
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local_time);
+    if (last_stamp_ != stamp) {
+        last_stamp_ = stamp;
+        sequence_ = 0;
+    }
+
+    while (true) {
+        std::string name = path_ + "." + stamp;
+        if (sequence_ != 0) name += "." + std::to_string(sequence_);
+        sequence_++;
+        if (!std::ifstream(name).good() && !std::ifstream(name + ".gz").good()) return name;
+    }
+}
+
+/**
+* @brief            Worker thread - close, compress queued segments and delete the ones beyond keep.
+*/
+void Logger_rotation::worker() {
+    lower_priority();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        if (jobs_.empty()) {
+            idle_condition_.notify_all();
+            if (stop_) break;
+            condition_.wait(lock);
+            continue;
+        }
+
+        Job job = std::move(jobs_.front());
+        jobs_.pop_front();
+        busy_ = true;
+        lock.unlock();
+
+        job.file.reset();
+        std::string segment = job.segment;
+        if (compress_) {
+            std::string compressed = segment + ".gz";
+            bool ok = policy_.compressor(segment, compressed);
+            if (ok) {
+                std::remove(segment.c_str());
+                segment = compressed;
+            }
+        }
+
+        lock.lock();
+        segments_.push_back(segment);
+        while (policy_.keep != 0 && segments_.size() > policy_.keep) {
+            std::remove(segments_.front().c_str());
+            segments_.pop_front();
+        }
+        busy_ = false;
+    }
+}
+
+/**
+* @brief            Run the calling thread at the lowest priority, so compression only uses idle CPU.
+*
+* Linux applies a nice value to the calling thread alone; other POSIX systems keep the default.
+*/
+void Logger_rotation::lower_priority() {
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#elif defined(__linux__)
+    if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19) != 0) {}
+#endif
+}
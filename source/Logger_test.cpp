@@ -1,9 +1,50 @@
 #include "../headers/logger_async.hh"
 #include "../headers/logger_test.hh"
+#include "../headers/Logger_decode.hh"
 
 #include <thread>
 #include <stdio.h>
 #include <cassert>
+#include <cstdlib>
+#include <algorithm>
+#include <new>
+
+#include <csignal>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief A value whose text grows every time it is printed, to catch arguments rendered more than once.
+ */
+struct Growing_value {
+    mutable int printed = 0;
+};
+
+static std::ostream& operator<<(std::ostream& stream, const Growing_value& value) {
+    value.printed++;
+    return stream << std::string(value.printed * 100, 'x');
+}
+
+/**
+ * @brief Number of operator new calls made by the test program, on any thread.
+ */
+static std::atomic<std::size_t> allocation_count(0);
+
+void* operator new(std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    void* memory = std::malloc(size ? size : 1);
+    if (!memory) throw std::bad_alloc();
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
 
 /**
  * @brief Constructor of the test.
@@ -26,15 +67,18 @@ Logger_test::~Logger_test()
  * @brief  Get the current time.
  */
 std::string Logger_test::get_time() {
-    time_t current_time = time(0);
-
-    char time_str[26];
-    errno_t error = ctime_s(time_str, sizeof(time_str), &current_time);
-
-    std::string time_ = convert_to_str(time_str);
-    time_.pop_back();
+    Logger_time_formatter formatter;
+    return formatter.format(Logger_clock::now());
+}
 
-    return time_;
+/**
+ * @brief           Cut the microseconds out of a "[Wed Jan 04 17:27:47.123456 2023]..." line.
+ * @param line      Log line or timestamp to shorten.
+ */
+std::string Logger_test::drop_microseconds(const std::string& line) {
+    std::size_t dot = line.find('.');
+    if (dot == std::string::npos || dot + 7 > line.size()) return line;
+    return line.substr(0, dot) + line.substr(dot + 7);
 }
 
 /**
@@ -75,7 +119,7 @@ void Logger_test::test_file_output(Logger_async &logger) {
         expected_output =  "[" + get_time() + "]"
                                         + " - [" + convert_to_str(thread_id) + "]\t-"
                                         + " Test message";
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        logger.flush(thread_id);
         
         std::ifstream file(Logger_test::list_test_file[1],std::ios::in);
         std::string line;
@@ -85,7 +129,7 @@ void Logger_test::test_file_output(Logger_async &logger) {
     }
 
     Logger_test::count_total_test();
-    if(line == expected_output){
+    if(drop_microseconds(line) == drop_microseconds(expected_output)){
         std::cout << "test_file_output: Passed" << std::endl;
     }
     else{
@@ -106,19 +150,21 @@ void Logger_test::test_file_output(Logger_async &logger) {
 void Logger_test::test_logger_multithread(Logger_async &logger) {
     std::vector<std::thread> threads;
     std::string file_path = Logger_test::list_test_file[2];
+    std::atomic<int> registered(0);
 
     for (int i = 0; i < 10; i++) {
-        threads.push_back(std::thread([&logger, &file_path] {
+        threads.push_back(std::thread([&logger, &file_path, &registered] {
             logger.add_output(std::this_thread::get_id(), Logger_async::Log_type::FileLog, file_path, true);
+            registered++;
         }));
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
     }
+    while (registered < 10) std::this_thread::yield();
 
     for (auto& thread : threads) {
         logger.add_log(thread.get_id(), "Log message from thread");
     }
 
-    std::this_thread::sleep_for(std::chrono::seconds(1));
+    logger.flush();
 
     std::ifstream log_file(Logger_test::list_test_file[2]);
     std::string line;
@@ -129,7 +175,6 @@ void Logger_test::test_logger_multithread(Logger_async &logger) {
     for (auto& thread : threads) {
         logger.remove_thread_ouput(thread.get_id());
         thread.join();
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
 
     log_file.close();
@@ -173,7 +218,7 @@ void Logger_test::test_huge_logs_load(Logger_async &logger, int num_line){
     thread1.join();
     thread2.join();
 
-    std::this_thread::sleep_for(std::chrono::seconds(5));
+    logger.flush();
 
     std::ifstream log_file(Logger_test::list_test_file[3]);
     std::string line;
@@ -181,7 +226,6 @@ void Logger_test::test_huge_logs_load(Logger_async &logger, int num_line){
     while (std::getline(log_file, line)) {
         line_count++;
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
     log_file.close();
 
     Logger_test::count_total_test();
@@ -197,6 +241,1047 @@ void Logger_test::test_huge_logs_load(Logger_async &logger, int num_line){
     logger.remove_thread_ouput(thread2_id);
 }
 
+/**
+ * @brief           Testing if arguments logged with a format are rendered by the daemon, values without a
+ *                  builtin encoding are printed once, and char* arguments are kept as text.
+ * @param logger    Logger to output message.
+ */
+void Logger_test::test_deferred_format(Logger_async &logger) {
+    std::string line;
+    std::string growing_line;
+    Growing_value growing;
+    std::thread t1([&] {
+        std::thread::id thread_id = std::this_thread::get_id();
+        char name[] = "mutable";
+        logger.add_output(thread_id, Logger_async::Log_type::FileLog, Logger_test::list_test_file[5], false);
+        logger.add_log(thread_id, "int={} double={} text={} flag={}", -42, 2.5, std::string("abc"), true);
+        logger.add_log(thread_id, "value={} name={}", growing, static_cast<char*>(name));
+        logger.flush(thread_id);
+
+        std::ifstream file(Logger_test::list_test_file[5], std::ios::in);
+        if (file.is_open()) {
+            getline(file, line);
+            getline(file, growing_line);
+        }
+        file.close();
+        logger.remove_thread_ouput(thread_id);
+    });
+    t1.join();
+
+    std::string expected_output = "\t- int=-42 double=2.5 text=abc flag=true";
+    std::string expected_growing = "\t- value=" + std::string(100, 'x') + " name=mutable";
+    Logger_test::count_total_test();
+    if (line.size() >= expected_output.size() && line.compare(line.size() - expected_output.size(), std::string::npos, expected_output) == 0
+        && growing.printed == 1 && growing_line.size() >= expected_growing.size()
+        && growing_line.compare(growing_line.size() - expected_growing.size(), std::string::npos, expected_growing) == 0) {
+        std::cout << "test_deferred_format: Passed" << std::endl;
+    }
+    else {
+        std::cout << "test_deferred_format: Failed" << std::endl;
+        Logger_test::count_failed_test();
+    }
+}
+
+/**
+ * @brief           Testing if the writev and O_DIRECT file backends write every line, in order.
+ * @param logger    Logger to output message.
+ * @param num_line  Number of lines written to each file.
+ */
+void Logger_test::test_file_backends(Logger_async &logger, int num_line) {
+    Logger_file::Backend backends[] = {Logger_file::Backend::Vectored, Logger_file::Backend::Direct};
+    bool err = false;
+
+    for (int i = 0; i < 2; i++) {
+        std::string path = Logger_test::list_test_file[6 + i];
+        std::thread t1([&] {
+            std::thread::id thread_id = std::this_thread::get_id();
+            logger.add_output(thread_id, std::make_shared<Logger_async::File_Log>(path, false, backends[i]));
+            for (int j = 0; j < num_line; j++) {
+                logger.add_log(thread_id, "Line {}", j);
+            }
+            logger.remove_thread_ouput(thread_id);
+        });
+        t1.join();
+        logger.flush();
+
+        int count = 0;
+        std::string line;
+        std::ifstream file(path, std::ios::in);
+        while (count < num_line && getline(file, line)) {
+            std::string expected_output = "\t- Line " + convert_to_str(count);
+            if (line.size() < expected_output.size() || line.compare(line.size() - expected_output.size(), std::string::npos, expected_output) != 0) break;
+            count++;
+        }
+        if (count != num_line) err = true;
+    }
+
+    Logger_test::count_total_test();
+    if (!err) {
+        std::cout << "test_file_backends: Passed" << std::endl;
+    }
+    else {
+        std::cout << "test_file_backends: Failed" << std::endl;
+        Logger_test::count_failed_test();
+    }
+}
+
+/**
+ * @brief           Testing if a full queue drops messages under Drop_newest and reports every drop.
+ * @param num_line  Number of messages logged into a queue of 8.
+ */
+void Logger_test::test_overload_policy(int num_line) {
+    int accepted = 0;
+    {
+        Logger_async logger(8);
+        logger.set_overload_policy(Logger_async::Overload_policy::Drop_newest);
+        std::thread t1([&] {
+            std::thread::id thread_id = std::this_thread::get_id();
+            logger.add_output(thread_id, Logger_async::Log_type::FileLog, Logger_test::list_test_file[8], false);
+            for (int i = 0; i < num_line; i++) {
+                if (logger.add_log(thread_id, "Line {}", i)) accepted++;
+            }
+            logger.remove_thread_ouput(thread_id);
+        });
+        t1.join();
+    }
+
+    int delivered = 0;
+    long dropped = 0;
+    std::string line;
+    std::string report = "Logger overload: ";
+    std::ifstream file(Logger_test::list_test_file[8], std::ios::in);
+    while (getline(file, line)) {
+        std::size_t position = line.find(report);
+        if (position != std::string::npos) dropped += std::atol(line.c_str() + position + report.size());
+        else if (line.find("\t- Line ") != std::string::npos) delivered++;
+    }
+
+    Logger_test::count_total_test();
+    if (delivered == accepted && accepted + dropped == num_line) {
+        std::cout << "test_overload_policy: Passed" << std::endl;
+    }
+    else {
+        std::cout << "test_overload_policy: Failed" << std::endl;
+        Logger_test::count_failed_test();
+    }
+}
+
+/**
+ * @brief           Testing if an output that blocks on every write does not hold up the other output of a thread.
+ * @param logger    Logger to output message.
+ * @param num_line  Number of messages logged.
+ */
+void Logger_test::test_slow_output(Logger_async &logger, int num_line) {
+    struct Counting_output : Logger_async::Output {
+        explicit Counting_output(int delay_ms) : delay(delay_ms), count(0) {}
+        void write_log(const std::string&) override {
+            if (delay) std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+            count++;
+        }
+        int delay;
+        std::atomic<int> count;
+    };
+
+    auto slow = std::make_shared<Counting_output>(5);
+    auto fast = std::make_shared<Counting_output>(0);
+    int slow_count = 0;
+    std::thread t1([&] {
+        std::thread::id thread_id = std::this_thread::get_id();
+        logger.add_output(thread_id, slow);
+        logger.add_output(thread_id, fast);
+        for (int i = 0; i < num_line; i++) {
+            logger.add_log(thread_id, "Line {}", i);
+        }
+        while (fast->count < num_line) std::this_thread::yield();
+        slow_count = slow->count;
+        logger.remove_thread_ouput(thread_id);
+    });
+    t1.join();
+
+    Logger_test::count_total_test();
+    if (slow_count < num_line) {
+        std::cout << "test_slow_output: Passed" << std::endl;
+    }
+    else {
+        std::cout << "test_slow_output: Failed" << std::endl;
+        Logger_test::count_failed_test();
+    }
+}
+
+/**
+ * @brief           Testing if a full lane holds blocking messages back instead of dropping them, and drops
+ *                  the messages of levels that drop on overload.
+ * @param logger    Logger to output message.
+ * @param num_line  Number of messages logged at each level.
+ */
+void Logger_test::test_lane_capacity(Logger_async &logger, int num_line) {
+    struct Counting_output : Logger_async::Output {
+        Counting_output() : count(0) {}
+        void write_log(const std::string&) override {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            count++;
+        }
+        std::atomic<int> count;
+    };
+
+    auto output = std::make_shared<Counting_output>();
+    logger.set_lane_capacity(8);
+    logger.set_overload_policy(Logger_async::LogLevel::DEBUG, Logger_async::Overload_policy::Drop_newest);
+    std::thread t1([&] {
+        std::thread::id thread_id = std::this_thread::get_id();
+        logger.add_output(thread_id, output);
+        for (int i = 0; i < num_line; i++) {
+            logger.add_log(thread_id, Logger_async::LogLevel::DEBUG, "Debug {}", i);
+            logger.add_log(thread_id, Logger_async::LogLevel::ERROR, "Error {}", i);
+        }
+        logger.remove_thread_ouput(thread_id);
+    });
+    t1.join();
+    logger.flush();
+    Logger_async::Output::Stats stats = output->stats();
+    logger.set_overload_policy(Logger_async::Overload_policy::Block);
+    logger.set_lane_capacity(Logger_async::Default_lane_capacity);
+
+    // Every ERROR line and the Thread_RM line are written; DEBUG lines are written or counted as dropped.
+    Logger_test::count_total_test();
+    if (stats.dropped > 0 && stats.dropped <= static_cast<std::uint64_t>(num_line)
+        && stats.written + stats.dropped == static_cast<std::uint64_t>(2 * num_line + 1)) {
+        std::cout << "test_lane_capacity: Passed" << std::endl;
+    }
+    else {
+        std::cout << "test_lane_capacity: Failed" << std::endl;
+        Logger_test::count_failed_test();
+    }
+}
+
+/**
+ * @brief           Testing if an output stuck beyond the lane capacity holds up only the threads routed to it.
+ * @param logger    Logger to output message.
+ * @param num_line  Number of messages logged to each output.
+ *
+ * Once the stuck output's backlog reaches the capacity, its thread logs num_line more messages and
+ * another thread logs to a file and flushes it; the flush must complete while the stuck output
+ * still blocks. The stuck output must then get every message once it is released.
+ */
+void Logger_test::test_stalled_output(Logger_async &logger, int num_line) {
+    struct Stalled_output : Logger_async::Output {
+        Stalled_output() : released(false), count(0) {}
+        void write_log(const std::string&) override {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return released; });
+            count++;
+        }
+        void release() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                released = true;
+            }
+            condition.notify_all();
+        }
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool released;
+        std::atomic<int> count;
+    };
+
+    auto stalled = std::make_shared<Stalled_output>();
+    std::atomic<int> stage(0);
+    logger.set_lane_capacity(8);
+    std::thread t1([&] {
+        std::thread::id thread_id = std::this_thread::get_id();
+        logger.add_output(thread_id, stalled);
+        for (int i = 0; i < num_line; i++) {
+            logger.add_log(thread_id, "Stalled {}", i);
+        }
+        while (stage.load() < 1) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        stage.store(2);
+        for (int i = 0; i < num_line; i++) {
+            logger.add_log(thread_id, "Stalled {}", num_line + i);
+        }
+        logger.remove_thread_ouput(thread_id);
+    });
+
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (stalled->stats().backlog < 8 && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    bool filled = stalled->stats().backlog >= 8;
+    stage.store(1);
+    while (stage.load() < 2) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    bool flushed = false;
+    std::thread t2([&] {
+        std::thread::id thread_id = std::this_thread::get_id();
+        logger.add_output(thread_id, Logger_async::Log_type::FileLog, Logger_test::list_test_file[27], false);
+        for (int i = 0; i < num_line; i++) {
+            logger.add_log(thread_id, "Line {}", i);
+        }
+        flushed = logger.flush_async(thread_id).wait_for(std::chrono::seconds(10)) == std::future_status::ready;
+        logger.remove_thread_ouput(thread_id);
+    });
+    t2.join();
+    bool stuck = stalled->count.load() == 0;
+
+    stalled->release();
+    t1.join();
+    logger.flush();
+    logger.set_lane_capacity(Logger_async::Default_lane_capacity);
+
+    int count = 0;
+    std::string line;
+    std::ifstream file(Logger_test::list_test_file[27], std::ios::in);
+    while (count < num_line && getline(file, line)) {
+        std::string expected_output = "\t- Line " + convert_to_str(count);
+        if (line.size() < expected_output.size() || line.compare(line.size() - expected_output.size(), std::string::npos, expected_output) != 0) break;
+        count++;
+    }
+
+    // The stuck output also gets the Thread_RM line.
+    Logger_test::count_total_test();
+    if (filled && flushed && stuck && count == num_line && stalled->count.load() == 2 * num_line + 1) {
+        std::cout << "test_stalled_output: Passed" << std::endl;
+    }
+    else {
+        std::cout << "test_stalled_output: Failed" << std::endl;
+        Logger_test::count_failed_test();
+    }
+}
+
+/**
+ * @brief           Testing if messages below the logger's level are skipped without evaluating their arguments.
+ * @param logger    Logger to output message.
+ */
+void Logger_test::test_log_level(Logger_async &logger) {
+    int evaluated = 0;
+    std::vector<std::string> lines;
+    std::thread t1([&] {
+        std::thread::id thread_id = std::this_thread::get_id();
+        logger.add_output(thread_id, Logger_async::Log_type::FileLog, Logger_test::list_test_file[9], false);
+        logger.set_log_level(Logger_async::LogLevel::WARNING);
+        LOGGER_ASYNC_DEBUG(logger, thread_id, "Debug {}", ++evaluated);
+        logger.add_log(thread_id, Logger_async::LogLevel::INFO, "Info");
+        LOGGER_ASYNC_ERROR(logger, thread_id, "Error {}", ++evaluated);
+        logger.set_log_level(Logger_async::LogLevel::TRACE);
+        logger.remove_thread_ouput(thread_id);
+    });
+    t1.join();
+    logger.flush();
+
+    std::string line;
+    std::ifstream file(Logger_test::list_test_file[9], std::ios::in);
+    while (getline(file, line)) {
+        lines.push_back(line);
+    }
+
+    std::string expected_output = "\t- [ERROR] Error 1";
+    Logger_test::count_total_test();
+    if (evaluated == 1 && lines.size() == 2 && lines[0].size() >= expected_output.size()
+        && lines[0].compare(lines[0].size() - expected_output.size(), std::string::npos, expected_output) == 0) {
+        std::cout << "test_log_level: Passed" << std::endl;
+    }
+    else {
+        std::cout << "test_log_level: Failed" << std::endl;
+        Logger_test::count_failed_test();
+    }
+}
+
+/**
+ * @brief           Testing if flush_async() completes only once the lane has written and flushed every queued line,
+ *                  even when the flush policy would hold them back.
+ * @param logger    Logger to output message.
+ * @param num_line  Number of messages logged.
+ */
+void Logger_test::test_flush(Logger_async &logger, int num_line) {
+    int count = 0;
+    logger.set_flush_policy(Logger_async::Flush_policy::Interval, 60000);
+    std::thread t1([&] {
+        std::thread::id thread_id = std::this_thread::get_id();
+        logger.add_output(thread_id, Logger_async::Log_type::FileLog, Logger_test::list_test_file[10], false);
+        for (int i = 0; i < num_line; i++) {
+            logger.add_log(thread_id, "Line {}", i);
+        }
+        std::future<void> done = logger.flush_async(thread_id);
+        done.wait();
+
+        std::string line;
+        std::ifstream file(Logger_test::list_test_file[10], std::ios::in);
+        while (getline(file, line)) {
+            count++;
+        }
+        logger.remove_thread_ouput(thread_id);
+    });
+    t1.join();
+    logger.set_flush_policy(Logger_async::Flush_policy::Per_batch);
+
+    Logger_test::count_total_test();
+    if (count == num_line) {
+        std::cout << "test_flush: Passed" << std::endl;
+    }
+    else {
+        std::cout << "test_flush: Failed" << std::endl;
+        Logger_test::count_failed_test();
+    }
+}
+
+/**
+ * @brief           Testing if a size-rotated file keeps only the newest segments, none above the size limit,
+ *                  and together with the current file they end with every line in order.
+ * @param logger    Logger to output message.
+ * @param num_line  Number of messages logged.
+ */
+void Logger_test::test_file_rotation(Logger_async &logger, int num_line) {
+    Logger_rotation::Policy policy;
+    policy.max_bytes = 4096;
+    policy.keep = 2;
+    std::string path = Logger_test::list_test_file[11];
+    auto output = std::make_shared<Logger_async::File_Log>(path, false, Logger_file::Backend::Stream, policy);
+
+    std::thread t1([&] {
+        std::thread::id thread_id = std::this_thread::get_id();
+        logger.add_output(thread_id, output);
+        for (int i = 0; i < num_line; i++) {
+            logger.add_log(thread_id, "Line {}", i);
+        }
+        logger.flush(thread_id);
+        logger.remove_thread_ouput(thread_id);
+    });
+    t1.join();
+    logger.flush();
+    output->rotation().wait_idle();
+
+    std::vector<std::string> files = output->rotation().segments();
+    bool err = files.size() != 2;
+    files.push_back(path);
+
+    std::vector<int> numbers;
+    for (const std::string& file_path : files) {
+        std::ifstream file(file_path, std::ios::in | std::ios::binary | std::ios::ate);
+        if (!file.is_open() || file.tellg() > 4096) err = true;
+        file.seekg(0);
+        std::string line;
+        while (getline(file, line)) {
+            std::size_t position = line.find("\t- Line ");
+            if (position != std::string::npos) numbers.push_back(std::atoi(line.c_str() + position + 8));
+        }
+        file.close();
+        if (file_path != path) remove(file_path.c_str());
+    }
+    for (std::size_t i = 0; i < numbers.size(); i++) {
+        if (numbers[i] != num_line - static_cast<int>(numbers.size() - i)) err = true;
+    }
+
+    Logger_test::count_total_test();
+    if (!err && !numbers.empty()) {
+        std::cout << "test_file_rotation: Passed" << std::endl;
+    }
+    else {
+        std::cout << "test_file_rotation: Failed" << std::endl;
+        Logger_test::count_failed_test();
+    }
+}
+
+/**
+ * @brief           Testing if CSV rows keep messages with dashes, commas and quotes in one correctly quoted field.
+ * @param logger    Logger to output message.
+ */
+void Logger_test::test_csv_output(Logger_async &logger) {
+    std::vector<std::string> lines;
+    std::thread t1([&] {
+        std::thread::id thread_id = std::this_thread::get_id();
+        logger.add_output(thread_id, Logger_async::Log_type::CSVLog, Logger_test::list_test_file[12], false);
+        logger.add_log(thread_id, Logger_async::LogLevel::WARNING, "Disk {} - said \"{}\", done", "a-b", "x,y");
+        logger.add_log(thread_id, "plain - text");
+        logger.flush(thread_id);
+
+        std::string line;
+        std::ifstream file(Logger_test::list_test_file[12], std::ios::in);
+        while (getline(file, line)) {
+            lines.push_back(line);
+        }
+        logger.remove_thread_ouput(thread_id);
+    });
+    t1.join();
+
+    std::string expected_level = ",WARNING,\"Disk a-b - said \"\"x,y\"\", done\"";
+    std::string expected_plain = ",,plain - text";
+    Logger_test::count_total_test();
+    if (lines.size() == 3 && lines[0] == "time,thread,level,message"
+        && lines[1].size() > expected_level.size() && lines[1].compare(lines[1].size() - expected_level.size(), std::string::npos, expected_level) == 0
+        && lines[2].size() > expected_plain.size() && lines[2].compare(lines[2].size() - expected_plain.size(), std::string::npos, expected_plain) == 0) {
+        std::cout << "test_csv_output: Passed" << std::endl;
+    }
+    else {
+        std::cout << "test_csv_output: Failed" << std::endl;
+        Logger_test::count_failed_test();
+    }
+}
+
+/**
+ * @brief           Testing if JSON objects keep the fields of a message apart from its text, with their types,
+ *                  and escape quotes and line breaks.
+ * @param logger    Logger to output message.
+ */
+void Logger_test::test_json_output(Logger_async &logger) {
+    std::vector<std::string> lines;
+    std::thread t1([&] {
+        std::thread::id thread_id = std::this_thread::get_id();
+        logger.add_output(thread_id, Logger_async::Log_type::JsonLog, Logger_test::list_test_file[13], false);
+        logger.add_log(thread_id, Logger_async::LogLevel::ERROR, "Request {} failed", 7,
+                       Logger_args::field("latency_us", 123), Logger_args::field("user", "a\"b"),
+                       Logger_args::field("ratio", 0.25), Logger_args::field("retry", false), Logger_args::field("delta", -5));
+        logger.add_log(thread_id, "line\nbreak");
+        logger.flush(thread_id);
+
+        std::string line;
+        std::ifstream file(Logger_test::list_test_file[13], std::ios::in);
+        while (getline(file, line)) {
+            lines.push_back(line);
+        }
+        logger.remove_thread_ouput(thread_id);
+    });
+    t1.join();
+
+    std::string expected_fields = ",\"level\":\"ERROR\",\"message\":\"Request 7 failed\",\"latency_us\":123,\"user\":\"a\\\"b\",\"ratio\":0.25,\"retry\":false,\"delta\":-5}";
+    std::string expected_plain = ",\"message\":\"line\\nbreak\"}";
+    Logger_test::count_total_test();
+    if (lines.size() == 2 && lines[0].compare(0, 9, "{\"ts_ns\":") == 0
+        && lines[0].size() > expected_fields.size() && lines[0].compare(lines[0].size() - expected_fields.size(), std::string::npos, expected_fields) == 0
+        && lines[1].size() > expected_plain.size() && lines[1].compare(lines[1].size() - expected_plain.size(), std::string::npos, expected_plain) == 0
+        && lines[1].find("\"level\"") == std::string::npos) {
+        std::cout << "test_json_output: Passed" << std::endl;
+    }
+    else {
+        std::cout << "test_json_output: Failed" << std::endl;
+        Logger_test::count_failed_test();
+    }
+}
+
+/**
+ * @brief           Testing if the console output sends ERROR messages to stderr and the rest to stdout,
+ *                  with stdout and stderr redirected to files.
+ * @param logger    Logger to output message.
+ */
+void Logger_test::test_console_output(Logger_async &logger) {
+    std::cout.flush();
+    int saved_out = dup(1);
+    int saved_err = dup(2);
+    int out_fd = open(Logger_test::list_test_file[16].c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int err_fd = open(Logger_test::list_test_file[17].c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    dup2(out_fd, 1);
+    dup2(err_fd, 2);
+
+    auto console = std::make_shared<Logger_async::Console_Log>();
+    std::thread t1([&] {
+        std::thread::id thread_id = std::this_thread::get_id();
+        logger.add_output(thread_id, console);
+        logger.add_log(thread_id, Logger_async::LogLevel::INFO, "Console info {}", 1);
+        logger.add_log(thread_id, Logger_async::LogLevel::ERROR, "Console error {}", 2);
+        logger.add_log(thread_id, "Console plain");
+        logger.flush(thread_id);
+        logger.remove_thread_ouput(thread_id);
+    });
+    t1.join();
+    logger.flush();
+
+    dup2(saved_out, 1);
+    dup2(saved_err, 2);
+    close(saved_out);
+    close(saved_err);
+    close(out_fd);
+    close(err_fd);
+
+    std::vector<std::string> out_lines, err_lines;
+    std::string line;
+    std::ifstream out_file(Logger_test::list_test_file[16], std::ios::in);
+    while (getline(out_file, line)) out_lines.push_back(line);
+    std::ifstream err_file(Logger_test::list_test_file[17], std::ios::in);
+    while (getline(err_file, line)) err_lines.push_back(line);
+
+    auto ends_with = [](const std::string& text, const std::string& end) {
+        return text.size() >= end.size() && text.compare(text.size() - end.size(), std::string::npos, end) == 0;
+    };
+    Logger_test::count_total_test();
+    if (out_lines.size() >= 2 && ends_with(out_lines[0], "[INFO] Console info 1") && ends_with(out_lines[1], "- Console plain")
+        && err_lines.size() == 1 && ends_with(err_lines[0], "[ERROR] Console error 2")) {
+        std::cout << "test_console_output: Passed" << std::endl;
+    }
+    else {
+        std::cout << "test_console_output: Failed" << std::endl;
+        Logger_test::count_failed_test();
+    }
+}
+
+/**
+ * @brief           Testing if steady-state logging allocates nothing - a round of messages through a file
+ *                  and a CSV output, flushed, costs no more allocations than a flush on its own.
+ * @param logger    Logger to output message.
+ * @param num_line  Number of messages per round.
+ *
+ * Pools may still grow when a round happens to queue more at once than any before, so the best of a
+ * few rounds counts; an allocation per message would show in every one of them.
+ */
+void Logger_test::test_allocations(Logger_async &logger, int num_line) {
+    std::size_t flush_only = 0;
+    std::size_t logging = 0;
+    std::thread t1([&] {
+        std::thread::id thread_id = std::this_thread::get_id();
+        logger.add_output(thread_id, Logger_async::Log_type::FileLog, Logger_test::list_test_file[14], false);
+        logger.add_output(thread_id, Logger_async::Log_type::CSVLog, Logger_test::list_test_file[15], false);
+        std::string text(100, 'x');
+
+        auto log_round = [&] {
+            for (int i = 0; i < num_line; i++) {
+                logger.add_log(thread_id, "A plain message that is too long for the short string buffer");
+                logger.add_log(thread_id, text);
+                logger.add_log(thread_id, "Request {} took {} us from {}", i, 1.5 * i, text);
+                logger.add_log(thread_id, Logger_async::LogLevel::WARNING, "Level {}", i);
+            }
+            logger.flush(thread_id);
+        };
+        for (int round = 0; round < 3; round++)
+            log_round();
+
+        std::size_t before = allocation_count.load();
+        logger.flush(thread_id);
+        flush_only = allocation_count.load() - before;
+
+        logging = static_cast<std::size_t>(-1);
+        for (int round = 0; round < 5 && logging > flush_only; round++) {
+            before = allocation_count.load();
+            log_round();
+            logging = std::min(logging, allocation_count.load() - before);
+        }
+        logger.remove_thread_ouput(thread_id);
+    });
+    t1.join();
+
+    Logger_test::count_total_test();
+    if (logging <= flush_only) {
+        std::cout << "test_allocations: Passed" << std::endl;
+    }
+    else {
+        std::cout << "test_allocations: Failed (" << logging << " allocations for " << 4 * num_line
+                  << " messages, " << flush_only << " for a flush)" << std::endl;
+        Logger_test::count_failed_test();
+    }
+}
+
+/**
+ * @brief           Testing if a crash loses no message - a child process logs to a file with a flush
+ *                  interval it never reaches and aborts; every message must then be in the file or
+ *                  in the crash file, with its fraction written as "%g" writes it.
+ * @param num_line  Number of messages.
+ *
+ * Half of the messages are logged a while before the abort, so they wait in the output's buffer;
+ * the rest are mostly still queued. Needs fork(), so it is skipped on Windows.
+ */
+void Logger_test::test_crash_flush(int num_line) {
+    std::ofstream(Logger_test::list_test_file[18], std::ios::out | std::ios::trunc);
+    std::ofstream(Logger_test::list_test_file[19], std::ios::out | std::ios::trunc);
+#ifdef _WIN32
+    std::cout << "test_crash_flush: Skipped" << std::endl;
+#else
+    std::cout.flush();
+    pid_t child = fork();
+    if (child == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, 1);
+        Logger_async logger;
+        logger.set_flush_policy(Logger_async::Flush_policy::Interval, 60000);
+        logger.enable_crash_flush(Logger_test::list_test_file[19]);
+        std::thread t1([&] {
+            std::thread::id thread_id = std::this_thread::get_id();
+            logger.add_output(thread_id, Logger_async::Log_type::FileLog, Logger_test::list_test_file[18], false);
+            for (int i = 0; i < num_line / 2; i++)
+                logger.add_log(thread_id, "Crash line {} {}", i, i / 7.0);
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            for (int i = num_line / 2; i < num_line; i++)
+                logger.add_log(thread_id, "Crash line {} {}", i, i / 7.0);
+            std::abort();
+        });
+        t1.join();
+        _exit(0);
+    }
+
+    int status = 0;
+    waitpid(child, &status, 0);
+
+    std::vector<bool> seen(num_line, false);
+    std::string line;
+    std::string text = "\t- Crash line ";
+    for (int i = 18; i <= 19; i++) {
+        std::ifstream file(Logger_test::list_test_file[i], std::ios::in);
+        while (getline(file, line)) {
+            std::size_t position = line.find(text);
+            if (position == std::string::npos) continue;
+            int number = std::atoi(line.c_str() + position + text.size());
+            char fraction[32];
+            snprintf(fraction, sizeof(fraction), " %g", number / 7.0);
+            bool exact = line.size() > std::strlen(fraction) && line.compare(line.size() - std::strlen(fraction), std::string::npos, fraction) == 0;
+            if (number >= 0 && number < num_line && exact) seen[number] = true;
+        }
+    }
+
+    Logger_test::count_total_test();
+    if (WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT && std::count(seen.begin(), seen.end(), true) == num_line) {
+        std::cout << "test_crash_flush: Passed" << std::endl;
+    }
+    else {
+        std::cout << "test_crash_flush: Failed (" << std::count(seen.begin(), seen.end(), true) << " of " << num_line << " messages saved)" << std::endl;
+        Logger_test::count_failed_test();
+    }
+#endif
+}
+
+/**
+ * @brief           Testing if rate-limited call sites log only what their limits let through, skip the
+ *                  arguments of the rest, and report every suppressed call.
+ * @param logger    Logger to output message.
+ * @param num_line  Number of calls made at each call site.
+ *
+ * Removing the thread's outputs reports the counts not reported yet, so all of them are in the file.
+ */
+void Logger_test::test_rate_limit(Logger_async &logger, int num_line) {
+    int evaluated = 0;
+    double seconds = 0;
+    std::thread t1([&] {
+        std::thread::id thread_id = std::this_thread::get_id();
+        logger.add_output(thread_id, Logger_async::Log_type::FileLog, Logger_test::list_test_file[20], false);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < num_line; i++) {
+            LOGGER_ASYNC_EVERY_N(logger, Logger_async::LogLevel::WARNING, thread_id, 100, "Every {}", ++evaluated);
+            LOGGER_ASYNC_FIRST_N(logger, Logger_async::LogLevel::WARNING, thread_id, 10, 1000, "First {}", i);
+            LOGGER_ASYNC_PER_SECOND(logger, Logger_async::LogLevel::WARNING, thread_id, 50, "Second {}", i);
+        }
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        logger.remove_thread_ouput(thread_id);
+    });
+    t1.join();
+    logger.flush();
+
+    int every = 0, first = 0, second = 0;
+    std::uint64_t suppressed = 0;
+    std::string line;
+    std::string report = "Logger rate limit: ";
+    std::ifstream file(Logger_test::list_test_file[20], std::ios::in);
+    while (getline(file, line)) {
+        std::size_t position = line.find(report);
+        if (position != std::string::npos) suppressed += std::strtoull(line.c_str() + position + report.size(), nullptr, 10);
+        else if (line.find("] Every ") != std::string::npos) every++;
+        else if (line.find("] First ") != std::string::npos) first++;
+        else if (line.find("] Second ") != std::string::npos) second++;
+    }
+
+    Logger_test::count_total_test();
+    if (evaluated == num_line / 100 && every == num_line / 100 && first == 10 + (num_line - 10 + 999) / 1000
+        && second >= 1 && second <= 50 * (1 + seconds) + 1 && suppressed == static_cast<std::uint64_t>(3 * num_line - every - first - second)) {
+        std::cout << "test_rate_limit: Passed" << std::endl;
+    }
+    else {
+        std::cout << "test_rate_limit: Failed" << std::endl;
+        Logger_test::count_failed_test();
+    }
+}
+
+/**
+ * @brief           Testing if identical consecutive messages are written once followed by their count,
+ *                  while a different message in between starts a new run.
+ * @param logger    Logger to output message.
+ * @param num_line  Number of copies of the repeated message.
+ */
+void Logger_test::test_compaction(Logger_async &logger, int num_line) {
+    std::vector<std::string> lines;
+    logger.set_compaction(true);
+    std::thread t1([&] {
+        std::thread::id thread_id = std::this_thread::get_id();
+        logger.add_output(thread_id, Logger_async::Log_type::FileLog, Logger_test::list_test_file[21], false);
+        for (int i = 0; i < num_line; i++)
+            logger.add_log(thread_id, Logger_async::LogLevel::ERROR, "Disk {} failed", 3);
+        logger.add_log(thread_id, "Other");
+        logger.add_log(thread_id, "Other");
+        logger.add_log(thread_id, Logger_async::LogLevel::ERROR, "Disk {} failed", 3);
+        logger.add_log(thread_id, Logger_async::LogLevel::ERROR, "Disk {} failed", 4);
+        logger.remove_thread_ouput(thread_id);
+    });
+    t1.join();
+    logger.flush();
+    logger.set_compaction(false);
+
+    std::string line;
+    std::ifstream file(Logger_test::list_test_file[21], std::ios::in);
+    while (getline(file, line)) {
+        lines.push_back(line.substr(line.find("\t- ") + 3));
+    }
+
+    std::string repeated = "[ERROR] Last message repeated " + convert_to_str(num_line - 1) + " times between ";
+    std::string repeated_once = "Last message repeated 1 times between ";
+    Logger_test::count_total_test();
+    if (lines.size() == 7 && lines[0] == "[ERROR] Disk 3 failed" && lines[1].compare(0, repeated.size(), repeated) == 0
+        && lines[2] == "Other" && lines[3].compare(0, repeated_once.size(), repeated_once) == 0
+        && lines[4] == "[ERROR] Disk 3 failed" && lines[5] == "[ERROR] Disk 4 failed" && lines[6] == "Thread_RM") {
+        std::cout << "test_compaction: Passed" << std::endl;
+    }
+    else {
+        std::cout << "test_compaction: Failed" << std::endl;
+        Logger_test::count_failed_test();
+    }
+}
+
+/**
+ * @brief           Testing if stats() counts the messages queued, their latencies and the work of each
+ *                  output, and if the periodic stats report reaches the thread's outputs.
+ * @param logger    Logger to output message.
+ * @param num_line  Number of messages to log.
+ */
+void Logger_test::test_stats(Logger_async &logger, int num_line) {
+    struct Counting_output : Logger_async::Output {
+        void write_log(const std::string&) override {}
+    };
+
+    auto output = std::make_shared<Counting_output>();
+    Logger_async::Stats before = logger.stats();
+    Logger_async::Stats after;
+    std::thread t1([&] {
+        std::thread::id thread_id = std::this_thread::get_id();
+        logger.add_output(thread_id, output);
+        logger.add_output(thread_id, Logger_async::Log_type::FileLog, Logger_test::list_test_file[22], false);
+        for (int i = 0; i < num_line; i++)
+            logger.add_log(thread_id, "Line {}", i);
+        logger.flush();
+        after = logger.stats();
+
+        logger.set_stats_report(thread_id, std::chrono::milliseconds(20));
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        logger.set_stats_report(thread_id, std::chrono::milliseconds(0));
+        logger.remove_thread_ouput(thread_id);
+    });
+    t1.join();
+    logger.flush();
+
+    std::uint64_t waited = 0, written = 0;
+    for (std::size_t i = 0; i < Logger_async::Latency_buckets; i++) {
+        waited += after.queue_latency[i] - before.queue_latency[i];
+        written += after.write_latency[i] - before.write_latency[i];
+    }
+    Logger_async::Output::Stats output_stats = {};
+    for (const auto& entry : after.outputs) {
+        if (entry.first == output.get()) output_stats = entry.second;
+    }
+
+    int reports = 0;
+    std::string line;
+    std::ifstream file(Logger_test::list_test_file[22], std::ios::in);
+    while (getline(file, line)) {
+        if (line.find("\t- [INFO] Logger stats: ") != std::string::npos) reports++;
+    }
+
+    Logger_test::count_total_test();
+    if (after.enqueued - before.enqueued >= static_cast<std::uint64_t>(num_line) && waited >= static_cast<std::uint64_t>(num_line)
+        && written >= 2 * static_cast<std::uint64_t>(num_line) && output_stats.written == static_cast<std::uint64_t>(num_line)
+        && output_stats.bytes > 0 && after.max_queue_depth > 0 && reports >= 2) {
+        std::cout << "test_stats: Passed" << std::endl;
+    }
+    else {
+        std::cout << "test_stats: Failed" << std::endl;
+        Logger_test::count_failed_test();
+    }
+}
+
+/**
+ * @brief           Testing if lines show the name set for a thread instead of its id, and if a thread
+ *                  registered again after its outputs were removed logs under the same name, while an
+ *                  unnamed thread given the freed slot logs under its own id.
+ * @param logger    Logger to output message.
+ */
+void Logger_test::test_thread_name(Logger_async &logger) {
+    std::vector<std::string> lines;
+    std::string id_text, other_text;
+    std::thread t1([&] {
+        std::thread::id thread_id = std::this_thread::get_id();
+        id_text = convert_to_str(thread_id);
+        logger.add_output(thread_id, Logger_async::Log_type::FileLog, Logger_test::list_test_file[23], false);
+        logger.add_log(thread_id, "Before");
+        logger.set_thread_name(thread_id, "worker-7");
+        logger.flush();
+        logger.add_log(thread_id, "Value {}", 1);
+        logger.remove_thread_ouput(thread_id);
+        logger.flush();
+        logger.add_output(thread_id, Logger_async::Log_type::FileLog, Logger_test::list_test_file[23], true);
+        logger.add_log(thread_id, "Again");
+        logger.remove_thread_ouput(thread_id);
+        logger.flush();
+
+        // Takes the slot t1 gave up, with its own id as text.
+        std::thread t2([&] {
+            std::thread::id other_id = std::this_thread::get_id();
+            other_text = convert_to_str(other_id);
+            logger.add_output(other_id, Logger_async::Log_type::FileLog, Logger_test::list_test_file[23], true);
+            logger.add_log(other_id, "Other");
+            logger.remove_thread_ouput(other_id);
+        });
+        t2.join();
+    });
+    t1.join();
+    logger.flush();
+
+    std::string line;
+    std::ifstream file(Logger_test::list_test_file[23], std::ios::in);
+    while (getline(file, line)) {
+        lines.push_back(line.substr(line.find("] - [") + 4));
+    }
+
+    Logger_test::count_total_test();
+    if (lines.size() == 7 && lines[0] == "[" + id_text + "]\t- Before" && lines[1] == "[worker-7]\t- Value 1"
+        && lines[2] == "[worker-7]\t- Thread_RM" && lines[3] == "[worker-7]\t- Again" && lines[4] == "[worker-7]\t- Thread_RM"
+        && lines[5] == "[" + other_text + "]\t- Other" && lines[6] == "[" + other_text + "]\t- Thread_RM") {
+        std::cout << "test_thread_name: Passed" << std::endl;
+    }
+    else {
+        std::cout << "test_thread_name: Failed" << std::endl;
+        Logger_test::count_failed_test();
+    }
+}
+
+/**
+ * @brief           Testing if a removal asked for by one thread keeps the messages another thread logged before it.
+ * @param logger    Logger to output message.
+ * @param num_line  Number of lines logged for the removed thread.
+ */
+void Logger_test::test_remove_order(Logger_async &logger, int num_line) {
+    // The target stays alive so no other thread is given its id. The rings are taken in the order
+    // remover, writer, flooder: while the daemon is busy with the flooder's queue the writer ends and
+    // the removal is asked for, so a pass may see the removal before the writer's last lines.
+    std::atomic<int> stage(0);
+    std::atomic<bool> flooding(true);
+    std::thread::id target_id;
+    std::thread target([&] {
+        target_id = std::this_thread::get_id();
+        logger.add_output(target_id, Logger_async::Log_type::FileLog, Logger_test::list_test_file[24], false);
+        stage.store(1);
+        while (stage.load() < 5) std::this_thread::yield();
+    });
+    std::thread remover([&] {
+        while (stage.load() < 1) std::this_thread::yield();
+        logger.add_log(target_id, "Line {}", 0);
+        stage.store(2);
+        while (stage.load() < 4) std::this_thread::yield();
+        logger.remove_thread_ouput(target_id);
+    });
+    std::thread writer([&] {
+        while (stage.load() < 2) std::this_thread::yield();
+        logger.add_log(target_id, "Line {}", 1);
+        stage.store(3);
+        for (int i = 2; i < num_line; i++)
+            logger.add_log(target_id, "Line {}", i);
+        stage.store(4);
+    });
+    std::thread flooder([&] {
+        std::thread::id thread_id = std::this_thread::get_id();
+        while (stage.load() < 3) std::this_thread::yield();
+        logger.add_output(thread_id, Logger_async::Log_type::FileLog, Logger_test::list_test_file[25], false);
+        while (flooding.load())
+            logger.add_log(thread_id, "Flood {}", 0);
+        logger.remove_thread_ouput(thread_id);
+    });
+    writer.join();
+    remover.join();
+    flooding.store(false);
+    flooder.join();
+    logger.flush();
+    stage.store(5);
+    target.join();
+
+    int count = 0;
+    bool in_order = true;
+    std::string line, last;
+    std::ifstream file(Logger_test::list_test_file[24], std::ios::in);
+    while (getline(file, line)) {
+        last = line.substr(line.find("]\t- ") + 4);
+        if (last != "Thread_RM" && last != "Line " + std::to_string(count)) in_order = false;
+        if (last != "Thread_RM") count++;
+    }
+
+    Logger_test::count_total_test();
+    if (in_order && count == num_line && last == "Thread_RM") {
+        std::cout << "test_remove_order: Passed" << std::endl;
+    }
+    else {
+        std::cout << "test_remove_order: Failed" << std::endl;
+        Logger_test::count_failed_test();
+    }
+}
+
+/**
+ * @brief           Testing if the decoder reads a truncated or corrupt binary log without reading past it.
+ * @param logger    Logger to output message.
+ * @param num_line  Number of lines logged into the file.
+ *
+ * The file is cut at every length, and every byte after the header is overwritten in turn; each
+ * copy must decode to a prefix of the whole file or stop, never crash. A string length raised past
+ * its record must reject that record alone.
+ */
+void Logger_test::test_decode_corrupt(Logger_async &logger, int num_line) {
+    std::thread t1([&] {
+        std::thread::id thread_id = std::this_thread::get_id();
+        logger.add_output(thread_id, Logger_async::Log_type::BinaryLog, Logger_test::list_test_file[26], false);
+        for (int i = 0; i < num_line; i++) {
+            logger.add_log(thread_id, "Line {} {}", i, std::string("abc"));
+        }
+        logger.remove_thread_ouput(thread_id);
+    });
+    t1.join();
+    logger.flush();
+
+    std::ifstream file(Logger_test::list_test_file[26], std::ios::in | std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+
+    // The removal adds a "Thread_RM" record after the lines.
+    std::size_t records = static_cast<std::size_t>(num_line) + 1;
+    std::istringstream whole_in(data);
+    std::ostringstream whole;
+    Logger_decode::Result whole_result = Logger_decode::decode(whole_in, whole, false);
+    bool err = whole_result.records != records || whole_result.truncated || !whole_result.error.empty();
+
+    for (std::size_t length = 0; length < data.size() && !err; length++) {
+        std::istringstream in(data.substr(0, length));
+        std::ostringstream out;
+        Logger_decode::Result result = Logger_decode::decode(in, out, false);
+        if (whole.str().compare(0, out.str().size(), out.str()) != 0 || result.records >= records) err = true;
+    }
+
+    for (std::size_t position = sizeof(Logger_binary::Magic); position < data.size(); position++) {
+        std::string corrupt = data;
+        corrupt[position] = static_cast<char>(0xff);
+        std::istringstream in(corrupt);
+        std::ostringstream out;
+        Logger_decode::decode(in, out, false);
+    }
+
+    const char text[] = {static_cast<char>(Logger_args::Type::String), 3, 0, 0, 0, 'a', 'b', 'c'};
+    std::string corrupt = data;
+    std::size_t position = corrupt.find(std::string(text, sizeof(text)));
+    if (position == std::string::npos) {
+        err = true;
+    }
+    else {
+        corrupt[position + 1] = 4;
+        std::istringstream in(corrupt);
+        std::ostringstream out;
+        Logger_decode::Result result = Logger_decode::decode(in, out, false);
+        if (result.rejected != 1 || result.records != records - 1) err = true;
+    }
+
+    Logger_test::count_total_test();
+    if (!err) {
+        std::cout << "test_decode_corrupt: Passed" << std::endl;
+    }
+    else {
+        std::cout << "test_decode_corrupt: Failed" << std::endl;
+        Logger_test::count_failed_test();
+    }
+}
+
 /**
  * @brief           Testing if API can create correct target log files. 
  * @param logger    Logger to output message.
@@ -210,7 +1295,7 @@ void Logger_test::test_logger_create_file(Logger_async &logger){
     });
     t1.join();
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    logger.flush();
     bool err = false;
 
     for (auto file : Logger_test::list_test_file){
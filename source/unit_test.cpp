@@ -6,17 +6,55 @@ int main()
     Logger_async logger;
     Logger_test test;
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
     test.test_handle_output_err(logger);
-    std::this_thread::sleep_for(std::chrono::seconds(1));
+    logger.flush();
     test.test_file_output(logger);
-    std::this_thread::sleep_for(std::chrono::seconds(1));
+    logger.flush();
     test.test_logger_multithread(logger);
-    std::this_thread::sleep_for(std::chrono::seconds(1));
+    logger.flush();
     test.test_huge_logs_load(logger, 10000);
-    std::this_thread::sleep_for(std::chrono::seconds(1));
+    logger.flush();
+    test.test_deferred_format(logger);
+    logger.flush();
+    test.test_file_backends(logger, 1000);
+    logger.flush();
+    test.test_overload_policy(1000);
+    logger.flush();
+    test.test_slow_output(logger, 200);
+    logger.flush();
+    test.test_lane_capacity(logger, 200);
+    logger.flush();
+    test.test_stalled_output(logger, 200);
+    logger.flush();
+    test.test_log_level(logger);
+    logger.flush();
+    test.test_flush(logger, 1000);
+    logger.flush();
+    test.test_file_rotation(logger, 1000);
+    logger.flush();
+    test.test_csv_output(logger);
+    logger.flush();
+    test.test_json_output(logger);
+    logger.flush();
+    test.test_allocations(logger, 1000);
+    logger.flush();
+    test.test_console_output(logger);
+    logger.flush();
+    test.test_crash_flush(1000);
+    logger.flush();
+    test.test_rate_limit(logger, 10000);
+    logger.flush();
+    test.test_compaction(logger, 1000);
+    logger.flush();
+    test.test_stats(logger, 1000);
+    logger.flush();
+    test.test_thread_name(logger);
+    logger.flush();
+    test.test_remove_order(logger, 1000);
+    logger.flush();
+    test.test_decode_corrupt(logger, 20);
+    logger.flush();
     test.test_logger_create_file(logger);
-    std::this_thread::sleep_for(std::chrono::seconds(1));
     test.test_report();
 
     return 0;